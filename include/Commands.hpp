@@ -6,6 +6,12 @@
 #include <variant>
 
 #include "types.hpp"
+#include "GeneratorUtils.hpp"
+#include "MonteCarlo.hpp"
+#include "Optimizer.hpp"
+#include "Reliability.hpp"
+#include "RollingHorizon.hpp"
+#include "Scheduler.hpp"
 
 //machine related commands
 struct AddMachineCommand
@@ -18,6 +24,12 @@ struct InitMachinesCommand
     std::vector<Machine> machines;
 };
 
+//job with its own parts and operations, the engine gives them its own ids
+struct AddOrderCommand
+{
+    JobOrder order;
+};
+
 // tool related commands
 struct AddToolCommand
 {
@@ -29,6 +41,12 @@ struct AddToolsCommand
     std::vector<Tool> tools;
 };
 
+//replaces the tool library keeping the ids, engines sharing one can exchange parts
+struct SetToolLibraryCommand
+{
+    std::map<ToolID, Tool> tools;
+};
+
 
 //operation related commands
 struct AddOperationCommand
@@ -43,12 +61,19 @@ struct AddPartCommand
     std::vector<Operation>& operations;
 };
 
-//job related commands
+//job related commands, the parts of an added job must already exist
 struct AddJobCommand
 {
     Job job;
 };
 
+//dueTime is in seconds of simulated production, infinity removes the due date
+struct SetJobDueDateCommand
+{
+    int jobId;
+    double dueTime;
+};
+
 //generator commands
 struct GenerateRandomMachinesCommand
 {
@@ -66,10 +91,83 @@ struct GenerateRandomJobsCommand
     int maxJobs;
 };
 
+//large synthetic workloads, generated in parallel
+struct GenerateBulkJobsCommand
+{
+    int count;
+};
+
 struct GenerateRandomPartCommand
 {
 };
 
+//changes the routing templates, quantities and setup families of generated parts
+struct SetRoutingConfigCommand
+{
+    RoutingConfig config;
+};
+
+//setup modeling and batching used by the optimizer
+struct SetScheduleOptionsCommand
+{
+    OptiProSimple::ScheduleOptions options;
+};
+
+//algorithm used by the full replan
+struct SetOptimizerBackendCommand
+{
+    OptiProSimple::BackendOptions options;
+};
+
+//window of the rolling horizon replan, enabled false plans the whole backlog at once
+struct SetHorizonCommand
+{
+    bool enabled;
+    OptiProSimple::HorizonOptions options;
+};
+
+//simulated seconds per real second
+struct SetTimeScaleCommand
+{
+    double multiplier;
+};
+
+//runs the simulation ahead without waiting for the clock
+struct FastForwardCommand
+{
+    double seconds;
+};
+
+//failure and repair distributions per machine type and size class
+struct SetReliabilityCommand
+{
+    ReliabilityModel model;
+};
+
+//runs the current plan many times under random failures and duration noise in the background
+struct RunMonteCarloCommand
+{
+    OptiProSimple::MonteCarloOptions options;
+};
+
+//plans and runs each scenario on a fork of the current state, the live engine is not touched
+struct RunWhatIfCommand
+{
+    std::vector<WhatIfScenario> scenarios;
+    OptiProSimple::MonteCarloOptions monteCarlo;
+};
+
+//starts the indicators again, to compare policies from the same point
+struct ResetKpisCommand
+{
+};
+
+//reseeds every generator stream so the next generated shop and failures can be reproduced
+struct SetSeedCommand
+{
+    uint64_t seed;
+};
+
 struct StopEgnineCommand
 {
 };
@@ -77,13 +175,28 @@ struct StopEgnineCommand
 using CommandVariant = std::variant<
     AddMachineCommand,
     AddJobCommand,
+    AddOrderCommand,
+    SetJobDueDateCommand,
     AddOperationCommand,
     AddPartCommand,
     AddToolCommand,
     AddToolsCommand,
+    SetToolLibraryCommand,
     GenerateRandomMachinesCommand,
     GenerateRandomJobsCommand,
+    GenerateBulkJobsCommand,
     GenerateRandomToolsCommand,
     GenerateRandomPartCommand,
+    SetRoutingConfigCommand,
+    SetScheduleOptionsCommand,
+    SetHorizonCommand,
+    SetOptimizerBackendCommand,
+    SetTimeScaleCommand,
+    FastForwardCommand,
+    SetReliabilityCommand,
+    RunMonteCarloCommand,
+    RunWhatIfCommand,
+    ResetKpisCommand,
+    SetSeedCommand,
     StopEgnineCommand
 >;
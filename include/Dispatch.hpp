@@ -0,0 +1,161 @@
+//
+// Load balanced dispatch of new operations onto machine queues
+//
+#pragma once
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <queue>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "types.hpp"
+
+// queued seconds of work per machine, kept in one min-heap per compatibility class
+// (machine type + specs) so the least loaded machine is found without scanning the shop
+class LoadBalancer
+{
+public:
+    // groups the machines into classes, known loads are kept
+    void build(const std::map<MachineID, Machine>& machines)
+    {
+        classes_.clear();
+        std::map<std::pair<MachineType, std::set<MachineSpecs>>, size_t> keys;
+        for (const auto& [mid, m] : machines)
+        {
+            auto [it, inserted] = keys.emplace(std::make_pair(m.machineType, m.machineSpecs), classes_.size());
+            if (inserted) classes_.push_back(Class{m.machineType, m.machineSpecs, {}, 0});
+            auto& slot = machines_[mid];
+            slot.cls = it->second;
+            ++slot.version;
+            push(classes_[slot.cls], Entry{slot.load, mid, slot.version});
+        }
+    }
+
+    double load(MachineID mid) const
+    {
+        auto it = machines_.find(mid);
+        return it != machines_.end() ? it->second.load : 0.0;
+    }
+
+    void add(MachineID mid, double seconds)
+    {
+        set(mid, load(mid) + seconds);
+    }
+
+    void set(MachineID mid, double seconds)
+    {
+        auto it = machines_.find(mid);
+        if (it == machines_.end() || it->second.cls >= classes_.size()) return;
+        auto& slot = it->second;
+        slot.load = std::max(0.0, seconds);
+        ++slot.version;
+        auto& cls = classes_[slot.cls];
+        ++cls.stale;
+        push(cls, Entry{slot.load, mid, slot.version});
+        // old entries are only skipped, drop them once they outnumber the live ones
+        if (cls.stale > cls.heap.size() / 2 + 16) compact(cls);
+    }
+
+    // machine of a compatible class minimising load + penalty(machine) among the ones accept() lets through
+    // heaps are walked in load order and stop once their load alone is above the best score, ties go to the lower id
+    template <typename Accept, typename Penalty>
+    MachineID pick(const Operation& op, Accept&& accept, Penalty&& penalty) const
+    {
+        MachineID best = -1;
+        double bestScore = 0.0;
+        std::vector<size_t> frontier;
+        for (const auto& cls : classes_)
+        {
+            if (cls.type != op.requiredMachine) continue;
+            if (!std::includes(cls.specs.begin(), cls.specs.end(),
+                               op.requiredMachineSpces.begin(), op.requiredMachineSpces.end())) continue;
+
+            // ordered walk of the binary heap, frontier holds heap indices ordered by their load
+            auto later = [&](size_t a, size_t b) { return after(cls.heap[a], cls.heap[b]); };
+            frontier.clear();
+            if (!cls.heap.empty()) frontier.push_back(0);
+            while (!frontier.empty())
+            {
+                std::pop_heap(frontier.begin(), frontier.end(), later);
+                const size_t i = frontier.back();
+                frontier.pop_back();
+                const Entry& e = cls.heap[i];
+                if (best >= 0 && e.load > bestScore) break;
+                for (size_t c : {2 * i + 1, 2 * i + 2})
+                {
+                    if (c < cls.heap.size())
+                    {
+                        frontier.push_back(c);
+                        std::push_heap(frontier.begin(), frontier.end(), later);
+                    }
+                }
+
+                if (machines_.at(e.machine).version != e.version || !accept(e.machine)) continue;
+                const double score = e.load + penalty(e.machine);
+                if (best < 0 || score < bestScore || (score == bestScore && e.machine < best))
+                {
+                    best = e.machine;
+                    bestScore = score;
+                }
+            }
+        }
+        return best;
+    }
+
+private:
+    struct Entry
+    {
+        double load;
+        MachineID machine;
+        uint64_t version;
+    };
+
+    struct Class
+    {
+        MachineType type;
+        std::set<MachineSpecs> specs;
+        std::vector<Entry> heap;
+        size_t stale = 0;
+    };
+
+    struct Slot
+    {
+        size_t cls = static_cast<size_t>(-1);
+        double load = 0.0;
+        uint64_t version = 0;
+    };
+
+    // min-heap order, ties on the lower machine id
+    static bool after(const Entry& a, const Entry& b)
+    {
+        return a.load != b.load ? a.load > b.load : a.machine > b.machine;
+    }
+
+    static void push(Class& cls, Entry e)
+    {
+        cls.heap.push_back(e);
+        std::push_heap(cls.heap.begin(), cls.heap.end(), after);
+    }
+
+    void compact(Class& cls) const
+    {
+        cls.heap.erase(std::remove_if(cls.heap.begin(), cls.heap.end(), [&](const Entry& e)
+        {
+            return machines_.at(e.machine).version != e.version;
+        }), cls.heap.end());
+        std::make_heap(cls.heap.begin(), cls.heap.end(), after);
+        cls.stale = 0;
+    }
+
+    std::vector<Class> classes_;
+    std::unordered_map<MachineID, Slot> machines_;
+};
+
+// work a queued operation adds before sequence dependent setups are known
+inline double queuedWork(const Operation& op)
+{
+    return static_cast<double>(op.setupTime) + static_cast<double>(op.machineTime) * op.quantity;
+}
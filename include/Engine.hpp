@@ -5,7 +5,10 @@
 #include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <cmath>
+#include <future>
 #include <iostream>
+#include <limits>
 #include <optional>
 #include <random>
 #include <thread>
@@ -15,15 +18,43 @@
 #include "GeneratorUtils.hpp"
 #include "utils.h"
 #include "Optimizer.hpp"
+#include "FixturePacking.hpp"
+#include "Dispatch.hpp"
+#include "KpiEngine.hpp"
+#include "Repair.hpp"
+#include "MonteCarlo.hpp"
+#include "Reliability.hpp"
+#include "RollingHorizon.hpp"
+#include "WhatIf.hpp"
+#include "Scheduler.hpp"
 #include <mutex>
 #include <unordered_set>
 
+// position of an open job in the optimizer priority index
+struct JobOrderKey
+{
+    int rank; // lower runs first
+    double due; // due time inside a rank, 0 when the objective ignores due dates
+    int jobId;
+
+    bool operator<(const JobOrderKey& other) const
+    {
+        if (rank != other.rank) return rank < other.rank;
+        if (due != other.due) return due < other.due;
+        return jobId < other.jobId;
+    }
+};
+
 class Engine
 {
 public:
-    explicit Engine(const std::chrono::milliseconds tick_period)
+    // seed = nullopt draws a random seed, pass one to make the whole run reproducible: generation, failures and
+    // background replans, which are then applied on the step after they were launched
+    explicit Engine(const std::chrono::milliseconds tick_period, std::optional<uint64_t> seed = std::nullopt)
         : running_{false},
           tickPeriod_(tick_period),
+          rng_(seed.value_or(randomSeed())),
+          deterministic_(seed.has_value()),
           nextMachineId_(0),
           nextJobId_(0),
           nextPartId_(0),
@@ -76,10 +107,16 @@ public:
         optimizeOnce();
     }
 
-    //VELOCIDAD DE PRODUCCION
+    //VELOCIDAD DE PRODUCCION, simulated seconds per real second
     void setTimerMultiplier(double multiplier)
     {
-        timer_multiplier_ = multiplier;
+        timer_multiplier_ = std::max(0.0, multiplier);
+    }
+
+    // simulated seconds since the engine started, plans and due dates are on this clock
+    double simulationTime() const
+    {
+        return state_.time;
     }
 
     double getTimerMultiplier() const
@@ -87,15 +124,21 @@ public:
         return timer_multiplier_;
     }
 
+    // master seed of the generator streams, log it to reproduce a run
+    uint64_t getSeed() const
+    {
+        return rng_.seed;
+    }
 
-    // Return a copy of the latest schedule
+
+    // Return a copy of the latest schedule, times in simulated seconds
     std::vector<OptiProSimple::ScheduledOp> getCurrentSchedule()
     {
         std::lock_guard<std::mutex> lk(schedule_mutex_);
         return current_schedule_;
     }
 
-    // Apply a schedule to the runtime state
+    // Apply a schedule to the runtime state, machines whose queue it leaves as is are not touched
     void applySchedule(const std::vector<OptiProSimple::ScheduledOp>& schedule)
     {
         std::unordered_map<MachineID, std::vector<OperationID>> assignments;
@@ -110,30 +153,30 @@ public:
             auto it = assignments.find(mid);
             if (it != assignments.end())
             {
-                for (auto opid : it->second) q.push(opid);
+                for (const auto& block : queueBlocks(it->second))
+                {
+                    for (OperationID opid : block) q.push(opid);
+                }
             }
+            if (q == m.operations && (q.empty() || machine_current_op_.count(mid))) continue;
             m.operations = std::move(q);
+            blocked_queues_.erase(mid);
+            tool_forecast_dirty_ = true;
             if (!m.operations.empty())
             {
                 m.status = MachineState::running;
-                if (machine_current_op_.find(mid) == machine_current_op_.end())
-                {
-                    OperationID next = m.operations.front();
-                    m.operations.pop();
-                    machine_current_op_[mid] = next;
-                    machine_remaining_time_[mid] = static_cast<double>(state_.operations[next].totalTime);
-                }
+                if (machine_current_op_.find(mid) == machine_current_op_.end()) startNextOperation(mid, m);
             }
-            else if (m.status != MachineState::error)
+            else if (m.status != MachineState::error && machine_current_op_.find(mid) == machine_current_op_.end())
             {
+                // nothing queued and nothing running, an operation in progress is left to finish
                 m.status = MachineState::idle;
-                machine_current_op_.erase(mid);
-                machine_remaining_time_.erase(mid);
             }
+            recountQueuedWork(mid);
         }
     }
 
-    // Simulate a machine failure, mark machine error and replan
+    // Simulate a machine failure, mark machine error and repair the plan around it
 
     void simulateMachineFailure(MachineID mid)
     {
@@ -143,23 +186,21 @@ public:
 
         it->second.status = MachineState::error;
         failed_handled_.insert(mid);
+        kpi_.machineFailed(mid);
 
+        // repair time from the reliability model, replaces the pending failure of the machine
+        failure_events_.schedule(state_.time + reliability_.profile(it->second).repair.sample(rng_.failures), mid,
+                                 FailureEvents::Kind::repair);
 
-        std::thread([this, mid]()
-        {
-            std::this_thread::sleep_for(std::chrono::seconds(15));
-
-            // Después de 15s → Recuperar la máquina
-            state_.machines[mid].status = MachineState::running;
-        }).detach();
-
-
+        // the operation in progress restarts from scratch wherever it goes
         std::vector<OperationID> toReassign;
         auto itcur = machine_current_op_.find(mid);
         if (itcur != machine_current_op_.end())
         {
             toReassign.push_back(itcur->second);
+            state_.operations[itcur->second].state = State::pending;
             machine_current_op_.erase(itcur);
+            kpi_.operationStopped(mid);
         }
         machine_remaining_time_.erase(mid);
 
@@ -169,65 +210,84 @@ public:
             toReassign.push_back(mops.front());
             mops.pop();
         }
+        if (toReassign.empty()) return;
 
-        // rebuild optimizer structures from current state
-        ProductionState snapshot = state_;
-        opt_graph_.clear();
-        OptiProSimple::build_graph_from_state(snapshot, opt_graph_);
-
-        opt_machines_.clear();
-        opt_machines_.reserve(snapshot.machines.size());
-        for (const auto& [mid2, mdata] : snapshot.machines)
+        // only the stopped machine's work moves, the other queues keep their order
+        std::unordered_map<MachineID, std::vector<OperationID>> queues;
+        for (const auto& [qid, m] : state_.machines)
         {
-            OptiProSimple::OptMachine om;
-            om.machine_id = mid2;
-            om.available = (mdata.status != MachineState::error);
-            om.available_time = 0.0;
-            opt_machines_.push_back(std::move(om));
+            auto& q = queues[qid];
+            for (auto copy = m.operations; !copy.empty(); copy.pop()) q.push_back(copy.front());
         }
-
-        std::vector<OptiProSimple::ScheduledOp> prior;
+        queues[mid] = toReassign;
+        std::unordered_map<MachineID, std::pair<OperationID, double>> running;
+        for (const auto& [rid, opid] : machine_current_op_)
         {
-            std::lock_guard<std::mutex> lk(schedule_mutex_);
-            prior = current_schedule_;
+            running[rid] = {opid, std::max(0.0, machine_remaining_time_[rid])};
         }
 
-        using clock = std::chrono::steady_clock;
-        double now = std::chrono::duration<double>(clock::now().time_since_epoch()).count();
-
-        auto new_schedule = OptiProSimple::handle_machine_failure(opt_graph_, opt_machines_, prior, snapshot, mid, now);
+        auto repaired = OptiProSimple::repair_machine_failure(state_, queues, running, mid, repair_options_);
+        if (!repaired.feasible)
+        {
+            // the queues cant be timed, hand the work out like new operations and replan in the background
+            // what no other machine takes waits for the repair, like the unplaced operations of a repair
+            for (OperationID opid : toReassign) dispatched_ops_.erase(opid);
+            dispatchOperations(toReassign);
+            for (OperationID opid : toReassign)
+            {
+                if (dispatched_ops_.insert(opid).second) mops.push(opid);
+            }
+            recountQueuedWork(mid);
+            reoptimize_wanted_ = true;
+            return;
+        }
 
+        for (auto& [qid, ops] : repaired.queues)
         {
-            std::lock_guard<std::mutex> lk(schedule_mutex_);
-            current_schedule_ = new_schedule;
+            std::queue<OperationID> q;
+            for (OperationID opid : ops) q.push(opid);
+            auto& m = state_.machines[qid];
+            m.operations = std::move(q);
+            if (m.status == MachineState::idle) m.status = MachineState::running;
+            recountQueuedWork(qid);
         }
+        for (OperationID opid : repaired.unplaced) mops.push(opid);
+        recountQueuedWork(mid);
+        tool_forecast_dirty_ = true;
 
-        applySchedule(new_schedule);
+        setCurrentSchedule(std::move(repaired.schedule), state_.time);
     }
 
 private:
-    // Random failure injector: simulates random machine stops
-    void monitorAndInjectFailures()
+    // next failure of a working machine, sampled once so ticks only look at the top of the event queue
+    void scheduleFailure(MachineID mid)
     {
-        static thread_local std::mt19937 rng{std::random_device{}()};
-
+        const auto& m = state_.machines[mid];
+        if (!(reliability_.profile(m).failure.mean > 0.0)) return;
+        failure_events_.schedule(state_.time + reliability_.profile(m).failure.sample(rng_.failures), mid,
+                                 FailureEvents::Kind::failure);
+    }
 
-        // Random machine stops, with probability
-        if (!state_.machines.empty())
+    // failures and repairs due by now
+    void processFailureEvents()
+    {
+        while (auto event = failure_events_.pop(state_.time))
         {
-            std::uniform_real_distribution<double> prob(0.0, 1.0);
-            double p = 0.01;
-            if (prob(rng) < p)
+            if (event->kind == FailureEvents::Kind::failure)
             {
-                std::uniform_int_distribution<size_t> pickm(0, state_.machines.size() - 1);
-                size_t idx = pickm(rng);
-                auto it = state_.machines.begin();
-                std::advance(it, idx);
-                if (it != state_.machines.end())
-                {
-                    simulateMachineFailure(it->first);
-                }
+                simulateMachineFailure(event->machine);
+                continue;
+            }
+            auto& m = state_.machines[event->machine];
+            if (m.status == MachineState::error)
+            {
+                m.status = machine_current_op_.count(event->machine) || !m.operations.empty()
+                               ? MachineState::running
+                               : MachineState::idle;
             }
+            failed_handled_.erase(event->machine);
+            kpi_.machineRepaired(event->machine);
+            scheduleFailure(event->machine);
         }
     }
 
@@ -235,27 +295,19 @@ private:
     void advanceProcessing(double seconds)
     {
         if (seconds <= 0.0) return;
+        state_.time += seconds;
+        kpi_.advance(seconds);
+        processFailureEvents();
+        horizon_elapsed_ += seconds;
+        if (rolling_horizon_ && horizon_options_.window_seconds > 0.0 &&
+            horizon_elapsed_ >= horizon_options_.reroll_fraction * horizon_options_.window_seconds)
+        {
+            reoptimize_wanted_ = true;
+        }
 
         for (auto& [mid, m] : state_.machines)
         {
-            if (machine_current_op_.find(mid) == machine_current_op_.end())
-            {
-                if (!m.operations.empty() && m.status != MachineState::error)
-                {
-                    OperationID next = m.operations.front();
-                    m.operations.pop();
-
-                    machine_current_op_[mid] = next;
-                    auto& op = state_.operations[next];
-                    double duration = static_cast<double>(op.totalTime);
-                    machine_remaining_time_[mid] = duration;
-                    m.status = MachineState::running;
-                    state_.operations[op.id].state = State::running;
-
-                    std::cout << "Máquina " << mid << " comenzó operación " << next << " (duración: " << duration <<
-                        "s)" << std::endl;
-                }
-            }
+            if (machine_current_op_.find(mid) == machine_current_op_.end()) startNextOperation(mid, m);
 
 
             auto itcur = machine_current_op_.find(mid);
@@ -264,97 +316,504 @@ private:
             OperationID curOp = itcur->second;
             double& rem = machine_remaining_time_[mid];
 
+            accumulateToolWear(state_.operations[curOp], rem, seconds);
             rem -= seconds;
 
             if (rem <= 0.0)
             {
                 std::cout << "Máquina " << mid << " COMPLETÓ operación " << curOp << std::endl;
+                loadBalancer().add(mid, -queuedWork(state_.operations[curOp]));
+                completeOperation(curOp);
+                kpi_.operationStopped(mid);
 
+                machine_current_op_.erase(mid);
+                machine_remaining_time_.erase(mid);
 
-                state_.operations[curOp].state = State::completed;
-                auto part_id = state_.operations[curOp].partId;
-                state_.parts[part_id].operations;
-                if (state_.operations[curOp].state == State::completed)
+                if (!startNextOperation(mid, m) && m.status != MachineState::error)
                 {
-                    //verificar las operations
-                    bool part_completed = false;
-                    for (auto operation : state_.parts[part_id].operations)
-                    {
-                        part_completed = state_.operations[operation].state == State::completed;
-                    }
-                    if (part_completed)
-                    {
-                        state_.parts[part_id].state = State::completed;
-                    }
-
-
-                    for (auto job : state_.jobs)
-                    {
-                        bool job_completed = false;
-
-                        bool job_in_part = false;
-                        for (auto part : job.second.parts)
-                        {
-                            job_completed = state_.parts[part.first].state == State::completed;
-                            job_in_part = part.first == part_id;
-                        }
-
-                        if (job_in_part && job_completed)
-                        {
-                            job.second.state = State::completed;
-                        }
-                    }
+                    std::cout << "Máquina " << mid << " ahora IDLE" << std::endl;
                 }
 
-
-                auto itop = state_.operations.find(curOp);
-                if (itop != state_.operations.end())
+                // If machine recovered from a previous handled failure, clear the handled flag
+                if (m.status != MachineState::error)
                 {
-                    itop->second.completed = true;
+                    auto fit = failed_handled_.find(mid);
+                    if (fit != failed_handled_.end()) failed_handled_.erase(fit);
                 }
+            }
+        }
+    }
 
-                machine_current_op_.erase(mid);
-                machine_remaining_time_.erase(mid);
 
-                if (!m.operations.empty() && m.status != MachineState::error)
+    // an operation starts once the one before it in its part routing is done
+    bool routingReady(OperationID opid) const
+    {
+        auto itpred = routing_pred_.find(opid);
+        if (itpred == routing_pred_.end()) return true;
+        auto itprev = state_.operations.find(itpred->second);
+        return itprev == state_.operations.end() || itprev->second.completed;
+    }
+
+    // how well op follows what the machine last ran: 0 same packed table, 1 same setup family, 2 anything else
+    int setupAffinity(MachineID mid, const Operation& op) const
+    {
+        auto itfix = machine_last_fixture_.find(mid);
+        if (op.fixtureGroup >= 0 && itfix != machine_last_fixture_.end() && itfix->second == op.fixtureGroup) return 0;
+        auto itfam = machine_last_family_.find(mid);
+        if (op.setupFamily >= 0 && itfam != machine_last_family_.end() && itfam->second == op.setupFamily) return 1;
+        return 2;
+    }
+
+    // starts the front operation when its routing predecessor is done, otherwise the ready one that keeps the
+    // loaded table or setup, then the first ready one; the rest keep their order except the queued members of the
+    // started op's table, which move up behind it so the table still runs back to back
+    // a queue with nothing ready is only scanned again once an operation it waits on completes or it changes
+    bool startNextOperation(MachineID mid, Machine& m)
+    {
+        if (m.status == MachineState::error) return false;
+        std::optional<OperationID> next;
+        auto itblocked = blocked_queues_.find(mid);
+        if (itblocked != blocked_queues_.end())
+        {
+            const auto& b = itblocked->second;
+            if (m.operations.empty() || b.size != m.operations.size() || b.front != m.operations.front() ||
+                b.back != m.operations.back())
+            {
+                blocked_queues_.erase(itblocked);
+            }
+            else
+            {
+                m.status = MachineState::idle;
+                return false;
+            }
+        }
+        if (!m.operations.empty() && routingReady(m.operations.front()))
+        {
+            next = m.operations.front();
+            m.operations.pop();
+        }
+        else if (!m.operations.empty())
+        {
+            std::vector<OperationID> queued;
+            queued.reserve(m.operations.size());
+            for (; !m.operations.empty(); m.operations.pop()) queued.push_back(m.operations.front());
+            int best = 3;
+            size_t chosen = 0;
+            for (size_t i = 0; i < queued.size() && best > 0; ++i)
+            {
+                if (!routingReady(queued[i])) continue;
+                const int affinity = setupAffinity(mid, state_.operations[queued[i]]);
+                if (affinity < best)
                 {
-                    OperationID next = m.operations.front();
-                    m.operations.pop();
-                    machine_current_op_[mid] = next;
-                    machine_remaining_time_[mid] = static_cast<double>(state_.operations[next].totalTime);
-                    m.status = MachineState::running;
-
-                    std::cout << "Máquina " << mid << " comenzó operación " << next << " (cola restante: " << m.
-                        operations.size() << ")" << std::endl;
-                    state_.operations[curOp].state = State::running;
-                    for (auto [PartId , part] : state_.parts)
-                    {
-                        if (part.operations.at(curOp))
-                        {
-                        }
-                    }
+                    best = affinity;
+                    chosen = i;
                 }
-                else
+            }
+            if (best < 3)
+            {
+                next = queued[chosen];
+                const int table = state_.operations[*next].fixtureGroup;
+                if (table >= 0)
                 {
-                    if (m.status != MachineState::error)
+                    for (size_t i = 0; i < queued.size(); ++i)
                     {
-                        m.status = MachineState::idle;
-                        std::cout << "Máquina " << mid << " ahora IDLE" << std::endl;
+                        if (i != chosen && state_.operations[queued[i]].fixtureGroup == table)
+                            m.operations.push(queued[i]);
                     }
                 }
+                for (size_t i = 0; i < queued.size(); ++i)
+                {
+                    if (i != chosen && (table < 0 || state_.operations[queued[i]].fixtureGroup != table))
+                        m.operations.push(queued[i]);
+                }
+            }
+            else
+            {
+                for (OperationID opid : queued)
+                {
+                    m.operations.push(opid);
+                    auto itpred = routing_pred_.find(opid);
+                    if (itpred != routing_pred_.end()) machines_waiting_on_[itpred->second].push_back(mid);
+                }
+                blocked_queues_[mid] = BlockedQueue{queued.size(), queued.front(), queued.back()};
+            }
+        }
+        if (!next)
+        {
+            m.status = MachineState::idle;
+            return false;
+        }
 
-                // If machine recovered from a previous handled failure, clear the handled flag
-                if (m.status != MachineState::error)
+        machine_current_op_[mid] = *next;
+        auto& op = state_.operations[*next];
+        const double duration = operationDuration(m, op);
+        machine_remaining_time_[mid] = duration;
+        m.status = MachineState::running;
+        op.state = State::running;
+        kpi_.operationStarted(mid);
+
+        std::cout << "Máquina " << mid << " comenzó operación " << *next << " (duración: " << duration <<
+            "s, cola restante: " << m.operations.size() << ")" << std::endl;
+        return true;
+    }
+
+    // marks the operation done and walks the reverse indices up to its part and the jobs using it
+    void completeOperation(OperationID opid)
+    {
+        auto itop = state_.operations.find(opid);
+        if (itop == state_.operations.end() || itop->second.completed) return;
+        itop->second.state = State::completed;
+        itop->second.completed = true;
+        dispatched_ops_.erase(opid); // only pending work is looked up, keeps the set to what is queued or running
+        routing_pred_.erase(opid);
+        auto itwaiting = machines_waiting_on_.find(opid);
+        if (itwaiting != machines_waiting_on_.end())
+        {
+            for (MachineID mid : itwaiting->second) blocked_queues_.erase(mid);
+            machines_waiting_on_.erase(itwaiting);
+        }
+        kpi_.operationCompleted();
+        if (horizon_window_.erase(opid) && rolling_horizon_ &&
+            horizon_window_size_ - horizon_window_.size() >= horizon_options_.reroll_fraction * horizon_window_size_)
+        {
+            reoptimize_wanted_ = true;
+        }
+
+        const PartID partId = itop->second.partId;
+        auto itrem = part_remaining_ops_.find(partId);
+        if (itrem == part_remaining_ops_.end() || --itrem->second > 0) return;
+        part_remaining_ops_.erase(itrem);
+        kpi_.partCompleted();
+        auto itpart = state_.parts.find(partId);
+        if (itpart != state_.parts.end()) itpart->second.state = State::completed;
+
+        auto itjobs = part_jobs_.find(partId);
+        if (itjobs == part_jobs_.end()) return;
+        for (int jobId : itjobs->second)
+        {
+            auto itjob = job_remaining_parts_.find(jobId);
+            if (itjob == job_remaining_parts_.end() || --itjob->second > 0) continue;
+            job_remaining_parts_.erase(itjob);
+            completeJob(jobId);
+        }
+    }
+
+    void completeJob(int jobId)
+    {
+        auto itjob = state_.jobs.find(jobId);
+        if (itjob == state_.jobs.end()) return;
+        itjob->second.state = State::completed;
+        itjob->second.finishedTime = state_.time;
+        kpi_.jobCompleted(jobId);
+        auto itkey = job_keys_.find(jobId);
+        if (itkey != job_keys_.end())
+        {
+            job_order_.erase(itkey->second);
+            job_keys_.erase(itkey);
+        }
+    }
+
+    // counts the operations of a new part that still have to run
+    void registerPart(const Part& part)
+    {
+        for (size_t k = 1; k < part.operations.size(); ++k) routing_pred_[part.operations[k]] = part.operations[k - 1];
+        int remaining = 0;
+        for (OperationID opid : part.operations)
+        {
+            auto itop = state_.operations.find(opid);
+            if (itop == state_.operations.end() || !itop->second.completed) ++remaining;
+        }
+        if (remaining > 0)
+        {
+            part_remaining_ops_[part.id] = remaining;
+            kpi_.partReleased();
+        }
+    }
+
+    // links a new job to its parts, the job must be in the state and its parts registered first
+    void registerJob(const Job& job)
+    {
+        kpi_.jobReleased(job.jobId, job.priority, job.dueTime);
+        const auto key = jobOrderKey(job);
+        job_keys_[job.jobId] = key;
+        job_order_.insert(key);
+        new_jobs_.push_back(job.jobId);
+
+        int remaining = 0;
+        for (const auto& [partId, qty] : job.parts)
+        {
+            part_jobs_[partId].push_back(job.jobId);
+            if (part_remaining_ops_.count(partId)) ++remaining;
+        }
+        if (remaining > 0) job_remaining_parts_[job.jobId] = remaining;
+        else completeJob(job.jobId);
+    }
+
+    // generated jobs are due a random multiple of their longest routing from now
+    void assignDueDate(Job& job)
+    {
+        if (job.dueTime < std::numeric_limits<double>::infinity()) return;
+        const float slack = randomDueSlack(rng_.jobs, routing_config_);
+        if (slack <= 0.0f) return;
+        double longest = 0.0;
+        for (const auto& [partId, qty] : job.parts)
+        {
+            auto itpart = state_.parts.find(partId);
+            if (itpart != state_.parts.end()) longest = std::max(longest, routingWork(itpart->second, state_.operations));
+        }
+        job.dueTime = state_.time + slack * longest;
+    }
+
+    // job from the command api, its parts must already exist
+    void addJob(Job job)
+    {
+        for (auto it = job.parts.begin(); it != job.parts.end();)
+        {
+            it = state_.parts.count(it->first) ? std::next(it) : job.parts.erase(it);
+        }
+        job.jobId = nextJobId_++;
+        job.createdTime = std::chrono::system_clock::now();
+        job.startedTime = std::chrono::system_clock::time_point{};
+        job.finishedTime = -1.0;
+        job.state = State::pending;
+        auto& stored = state_.jobs[job.jobId];
+        stored = std::move(job);
+        registerJob(stored);
+    }
+
+    // job that brought its own parts and operations, they get ids of this engine
+    // fixture groups are packed again by this engine, jobs without a due date get one like generated jobs
+    void addOrder(const JobOrder& order)
+    {
+        std::unordered_map<OperationID, const Operation*> operations;
+        for (const auto& op : order.operations) operations[op.id] = &op;
+        Job job = order.job;
+        job.parts.clear();
+        for (const auto& source : order.parts)
+        {
+            auto itqty = order.job.parts.find(source.id);
+            if (itqty == order.job.parts.end()) continue;
+            Part part = source;
+            part.id = nextPartId_++;
+            part.state = State::pending;
+            part.operations.clear();
+            for (OperationID opid : source.operations)
+            {
+                auto itop = operations.find(opid);
+                if (itop == operations.end()) continue;
+                Operation op = *itop->second;
+                op.id = nextOperationId_++;
+                op.partId = part.id;
+                op.state = State::pending;
+                op.completed = false;
+                op.fixtureGroup = -1;
+                part.operations.push_back(op.id);
+                state_.operations[op.id] = std::move(op);
+            }
+            job.parts[part.id] = itqty->second;
+            registerPart(part);
+            state_.parts[part.id] = std::move(part);
+        }
+        if (job.parts.empty()) return;
+        assignDueDate(job);
+        addJob(std::move(job));
+    }
+
+    // a new due date moves the job in the priority index and asks for a replan
+    void setJobDueDate(int jobId, double dueTime)
+    {
+        auto itjob = state_.jobs.find(jobId);
+        if (itjob == state_.jobs.end()) return;
+        itjob->second.dueTime = dueTime;
+        kpi_.jobDueChanged(jobId, dueTime);
+        auto itkey = job_keys_.find(jobId);
+        if (itkey == job_keys_.end()) return;
+        job_order_.erase(itkey->second);
+        itkey->second = jobOrderKey(itjob->second);
+        job_order_.insert(itkey->second);
+        reoptimize_wanted_ = true;
+    }
+
+    // keys depend on the objective, the index is rebuilt when it changes
+    void rebuildJobOrder()
+    {
+        job_order_.clear();
+        for (auto& [jobId, key] : job_keys_)
+        {
+            key = jobOrderKey(state_.jobs.at(jobId));
+            job_order_.insert(key);
+        }
+    }
+
+    ToolMagazine& magazineFor(const Machine& m)
+    {
+        auto it = magazines_.find(m.id);
+        if (it == magazines_.end()) it = magazines_.emplace(m.id, ToolMagazine::fromMachine(m)).first;
+        return it->second;
+    }
+
+    // time the machine needs for op when it starts now, then loads the tools op needs into its magazine
+    // the setup depends on the tools it already carries and the previous family
+    double operationDuration(Machine& m, const Operation& op)
+    {
+        auto& magazine = magazineFor(m);
+        auto itfam = machine_last_family_.find(m.id);
+        const int lastFamily = itfam != machine_last_family_.end() ? itfam->second : -1;
+        auto itfix = machine_last_fixture_.find(m.id);
+        const int lastFixture = itfix != machine_last_fixture_.end() ? itfix->second : -1;
+        double duration = OptiProSimple::effective_duration(op, magazine, lastFamily, lastFixture, schedule_options_);
+        magazine.load(op, [&m](uint16_t slot, ToolID tool) { m.tools[slot] = tool; });
+        machine_last_family_[m.id] = op.setupFamily;
+        machine_last_fixture_[m.id] = op.fixtureGroup;
+        duration += replaceWornTools(m, op);
+        tool_forecast_dirty_ = true;
+        return duration;
+    }
+
+    static double cuttingTime(const Operation& op)
+    {
+        return static_cast<double>(op.machineTime) * static_cast<double>(op.quantity);
+    }
+
+    // wears the tools of the running op, tools only cut during the last cuttingTime seconds of the op
+    // a tool worn out while a batch longer than its life cuts is swapped for a fresh one, the time of the swap was
+    // added when the op started; O(tools of the op), the library is never scanned
+    void accumulateToolWear(const Operation& op, double remaining, double seconds)
+    {
+        const double cutting = cuttingTime(op);
+        const double before = std::max(0.0, remaining);
+        const double after = std::max(0.0, remaining - seconds);
+        const double cut = std::min(before, cutting) - std::min(after, cutting);
+        if (cut <= 0.0) return;
+
+        for (ToolID t : op.tools)
+        {
+            auto itTool = state_.tools.find(t);
+            if (itTool == state_.tools.end()) continue;
+            double& accum = tool_wear_accum_[t];
+            accum += cut;
+            const double whole = std::floor(accum);
+            if (whole < 1.0) continue;
+            accum -= whole;
+            auto& tool = itTool->second;
+            double life = tool.currentToolLife - whole;
+            while (life < 0.0 && tool.maxToolLife > 0)
+            {
+                life += tool.maxToolLife;
+                ++tool_replacements_;
+            }
+            tool.currentToolLife = static_cast<uint16_t>(std::max(0.0, life));
+        }
+    }
+
+    // swaps a fresh tool of life needs while cutting seconds, 0 when one lasts the whole cut
+    static int midOperationSwaps(const Tool& tool, double cutting)
+    {
+        if (tool.maxToolLife == 0 || cutting <= tool.maxToolLife) return 0;
+        return static_cast<int>(std::ceil(cutting / tool.maxToolLife)) - 1;
+    }
+
+    // replaces tools that would die during op before it starts and right shifts the machine plan, a batch cutting
+    // longer than a fresh tool lasts also pays for the swaps it will need on the way
+    // returns the extra seconds the replacements add to the op
+    double replaceWornTools(const Machine& m, const Operation& op)
+    {
+        const double cutting = cuttingTime(op);
+        double extra = 0.0;
+        for (ToolID t : op.tools)
+        {
+            auto itTool = state_.tools.find(t);
+            if (itTool == state_.tools.end()) continue;
+            auto& tool = itTool->second;
+            if (tool.currentToolLife - tool_wear_accum_[t] >= cutting) continue;
+            tool.currentToolLife = tool.maxToolLife;
+            tool_wear_accum_[t] = 0.0;
+            ++tool_replacements_;
+            extra += tool_replacement_time_ * (1 + midOperationSwaps(tool, cutting));
+        }
+        if (extra > 0.0)
+        {
+            std::lock_guard<std::mutex> lk(schedule_mutex_);
+            auto itPlanned = schedule_index_.find(op.id);
+            auto itMachine = schedule_machine_index_.find(m.id);
+            if (itPlanned != schedule_index_.end() && itMachine != schedule_machine_index_.end())
+            {
+                const double opStart = current_schedule_[itPlanned->second].start;
+                for (size_t i : itMachine->second)
                 {
-                    auto fit = failed_handled_.find(mid);
-                    if (fit != failed_handled_.end()) failed_handled_.erase(fit);
+                    auto& s = current_schedule_[i];
+                    if (s.op_id == op.id) s.end += extra;
+                    else if (s.start >= opStart)
+                    {
+                        s.start += extra;
+                        s.end += extra;
+                    }
                 }
             }
         }
+        return extra;
     }
 
+    // walks the running operations and then the machine queues in estimated start order and reports the first
+    // operation each tool cannot finish, only recomputed when the plan changed
+    void forecastToolExpiry()
+    {
+        struct PlannedUse
+        {
+            double start;
+            MachineID machine;
+            OperationID op;
+            double cutting; // seconds the op still cuts
+        };
+        std::vector<PlannedUse> uses;
+        for (auto& [mid, m] : state_.machines)
+        {
+            double t = 0.0;
+            auto itcur = machine_current_op_.find(mid);
+            if (itcur != machine_current_op_.end())
+            {
+                t = std::max(0.0, machine_remaining_time_[mid]);
+                // the running op cuts at the end, only what is left of it still wears its tools
+                uses.push_back({0.0, mid, itcur->second, std::min(t, cuttingTime(state_.operations[itcur->second]))});
+            }
+            auto queue = m.operations;
+            while (!queue.empty())
+            {
+                const OperationID opid = queue.front();
+                queue.pop();
+                const auto& op = state_.operations[opid];
+                uses.push_back({t, mid, opid, cuttingTime(op)});
+                t += static_cast<double>(op.totalTime);
+            }
+        }
+        std::sort(uses.begin(), uses.end(), [](const PlannedUse& a, const PlannedUse& b) { return a.start < b.start; });
 
-    int jobs_size_mem = 0;
+        std::unordered_map<ToolID, double> life;
+        std::unordered_set<ToolID> expired;
+        tool_expiries_.clear();
+        for (const auto& use : uses)
+        {
+            const auto& op = state_.operations[use.op];
+            for (ToolID t : op.tools)
+            {
+                if (expired.count(t)) continue;
+                auto itTool = state_.tools.find(t);
+                if (itTool == state_.tools.end()) continue;
+                auto itLife = life.find(t);
+                if (itLife == life.end())
+                {
+                    itLife = life.emplace(t, itTool->second.currentToolLife - tool_wear_accum_[t]).first;
+                }
+                itLife->second -= use.cutting;
+                if (itLife->second < 0.0)
+                {
+                    expired.insert(t);
+                    tool_expiries_.push_back(ToolExpiry{t, use.machine, use.op, use.start});
+                }
+            }
+        }
+        tool_forecast_dirty_ = false;
+    }
 
     void run()
     {
@@ -388,9 +847,7 @@ private:
                 //Pasarle el Frame al GUI
 
 
-                advanceProcessing(dt);
-                monitorAndInjectFailures();
-                optimizeOnce();
+                simulate(dt * timer_multiplier_);
                 publishSnashot();
                 nextTick += tickPeriod_;
             }
@@ -428,6 +885,12 @@ private:
 
     void handleCommand(const AddJobCommand& command)
     {
+        addJob(command.job);
+    }
+
+    void handleCommand(const SetJobDueDateCommand& command)
+    {
+        setJobDueDate(command.jobId, command.dueTime);
     }
 
     void handleCommand(const AddMachineCommand& command)
@@ -448,6 +911,18 @@ private:
         addTool(command.tool);
     }
 
+    void handleCommand(const AddOrderCommand& command)
+    {
+        addOrder(command.order);
+    }
+
+    void handleCommand(const SetToolLibraryCommand& command)
+    {
+        state_.tools = command.tools;
+        nextToolId_ = state_.tools.empty() ? 0 : state_.tools.rbegin()->first + 1;
+        tool_forecast_dirty_ = true;
+    }
+
     void handleCommand(const AddToolsCommand& command)
     {
         for (auto& tool : command.tools)
@@ -466,10 +941,122 @@ private:
         generateRandomJobs(command.minJobs, command.maxJobs);
     }
 
+    void handleCommand(const GenerateBulkJobsCommand& command)
+    {
+        generateBulkJobs(command.count);
+    }
+
+    void handleCommand(const SetRoutingConfigCommand& command)
+    {
+        routing_config_ = command.config;
+    }
+
+    void handleCommand(const SetScheduleOptionsCommand& command)
+    {
+        const bool reorder = command.options.objective != schedule_options_.objective;
+        schedule_options_ = command.options;
+        if (reorder)
+        {
+            rebuildJobOrder();
+            reoptimize_wanted_ = true;
+        }
+    }
+
+    void handleCommand(const SetHorizonCommand& command)
+    {
+        rolling_horizon_ = command.enabled;
+        horizon_options_ = command.options;
+        reoptimize_wanted_ = true;
+    }
+
+    void handleCommand(const SetOptimizerBackendCommand& command)
+    {
+        backend_options_ = command.options;
+        reoptimize_wanted_ = true;
+    }
+
+    void handleCommand(const SetTimeScaleCommand& command)
+    {
+        setTimerMultiplier(command.multiplier);
+    }
+
+    void handleCommand(const FastForwardCommand& command)
+    {
+        simulate(command.seconds);
+    }
+
+    void handleCommand(const SetReliabilityCommand& command)
+    {
+        setReliability(command.model);
+    }
+
+    void handleCommand(const RunMonteCarloCommand& command)
+    {
+        if (robustness_future_.valid()) return;
+        robustness_future_ = std::async(std::launch::async,
+                                        [snapshot = state_, plan = executionPlan(), reliability = reliability_,
+                                            options = command.options]()
+                                        {
+                                            return OptiProSimple::monte_carlo_schedule(
+                                                snapshot, plan, reliability, options);
+                                        });
+    }
+
+    // one copy of the state and one baseline for all the scenarios of the command, they run on their own threads
+    void handleCommand(const RunWhatIfCommand& command)
+    {
+        if (command.scenarios.empty()) return;
+        auto fork = std::make_shared<OptiProSimple::ScenarioFork>();
+        fork->state = std::make_shared<const ProductionState>(state_);
+        fork->running = runningOperations();
+        fork->options = schedule_options_;
+        fork->backend = backend_options_;
+        fork->reliability = reliability_;
+        fork->monte_carlo = command.monteCarlo;
+        for (const auto& scenario : command.scenarios) sandbox_.submit(fork, scenario);
+    }
+
+    void handleCommand(const ResetKpisCommand& command)
+    {
+        kpi_.reset();
+    }
+
+    void handleCommand(const SetSeedCommand& command)
+    {
+        rng_.reseed(command.seed);
+        deterministic_ = true;
+        // pending failures come from the new stream too
+        setReliability(reliability_);
+        std::cout << "Engine seed: " << rng_.seed << std::endl;
+    }
+
+    // runs the shop for simulated seconds in steps short enough that a machine finishes at most one operation
+    // per step, steps end at the next failure or repair so it happens on time
+    void simulate(double seconds)
+    {
+        while (seconds > 0.0)
+        {
+            double step = std::min(seconds, max_step_seconds_);
+            step = std::min(step, std::max(failure_events_.next() - state_.time, 1e-3));
+            advanceProcessing(step);
+            optimizeOnce();
+            seconds -= step;
+        }
+    }
+
+    // new failure and repair distributions, the pending failures are drawn again from them
+    void setReliability(const ReliabilityModel& model)
+    {
+        reliability_ = model;
+        for (const auto& [mid, m] : state_.machines)
+        {
+            if (!failed_handled_.count(mid)) scheduleFailure(mid);
+        }
+    }
+
     void optimizeOnce()
     {
         state_.count++;
-        std::vector<Job> ordered;
         for (auto i = state_.machines.begin(); i != state_.machines.end(); ++i)
         {
             if (i->second.status == MachineState::error)
@@ -482,62 +1069,333 @@ private:
         }
 
         //NUEVO JOB
-        if (jobs_size_mem != state_.jobs.size())
+        if (!new_jobs_.empty()) insertNewJobs();
+
+        if (robustness_future_.valid() &&
+            robustness_future_.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            robustness_ = robustness_future_.get();
+        while (auto result = sandbox_.poll())
         {
-            //PRIORIDAD DE JOBS:
+            what_if_results_.push_back(std::move(*result));
+            if (what_if_results_.size() > max_what_if_results_) what_if_results_.erase(what_if_results_.begin());
+        }
 
-            static const std::unordered_map<Priority, int> prioOrder = {
-                {Priority::low, 0},
-                {Priority::normal, 1},
-                {Priority::high, 2},
-                {Priority::urgent, 3},
-            };
+        if (schedule_options_.background_reoptimize)
+        {
+            collectReoptimization();
+            if (reoptimize_wanted_ && !reoptimize_future_.valid()) launchReoptimization();
+        }
+    }
+
+    // rank of a job in the priority index, initialized jobs first and then by urgency
+    // the tardiness objectives order by due date instead, jobs without one follow by urgency
+    JobOrderKey jobOrderKey(const Job& job) const
+    {
+        const int group = job.initialized ? 0 : 5;
+        if (schedule_options_.objective != OptiProSimple::ScheduleObjective::makespan &&
+            job.dueTime < std::numeric_limits<double>::infinity())
+            return JobOrderKey{group, job.dueTime, job.jobId};
+        return JobOrderKey{group + 4 - priorityLevel(job.priority), 0.0, job.jobId};
+    }
+
+    // most urgent key among the jobs using the part of an operation
+    JobOrderKey operationRank(OperationID opid) const
+    {
+        JobOrderKey rank{std::numeric_limits<int>::max(), 0.0, std::numeric_limits<int>::max()};
+        auto itop = state_.operations.find(opid);
+        if (itop == state_.operations.end()) return rank;
+        auto itjobs = part_jobs_.find(itop->second.partId);
+        if (itjobs == part_jobs_.end()) return rank;
+        for (int jobId : itjobs->second)
+        {
+            auto itkey = job_keys_.find(jobId);
+            if (itkey != job_keys_.end() && itkey->second < rank) rank = itkey->second;
+        }
+        return rank;
+    }
 
-            auto cmp = [&](const Job& a, const Job& b)
+    // only the jobs that arrived since the last tick are planned, in priority order
+    // their operations are inserted into the machine queues ahead of less urgent work
+    void insertNewJobs()
+    {
+        std::vector<JobOrderKey> arrived;
+        arrived.reserve(new_jobs_.size());
+        for (int jobId : new_jobs_)
+        {
+            auto itkey = job_keys_.find(jobId);
+            if (itkey != job_keys_.end()) arrived.push_back(itkey->second);
+        }
+        new_jobs_.clear();
+        std::sort(arrived.begin(), arrived.end());
+
+        std::vector<OperationID> ops;
+        for (const auto& key : arrived)
+        {
+            auto& job = state_.jobs[key.jobId];
+            for (const auto& [partId, qty] : job.parts)
             {
-                // 1. initialized=true primero
-                if (a.initialized != b.initialized)
-                    return a.initialized; // true primero
+                auto itpart = state_.parts.find(partId);
+                if (itpart == state_.parts.end()) continue;
+                for (OperationID opid : itpart->second.operations)
+                {
+                    const auto& op = state_.operations[opid];
+                    if (op.state == State::pending && !dispatched_ops_.count(opid)) ops.push_back(opid);
+                }
+            }
+            if (job.state == State::pending) job.state = State::running;
+        }
 
-                // 2. prioridad
-                if (a.priority != b.priority)
-                    return static_cast<int>(a.priority) > static_cast<int>(b.priority);
+        staging_ = true;
+        dispatchOperations(ops);
+        staging_ = false;
+        flushStagedOperations();
+        reoptimize_wanted_ = true;
+    }
 
-                // 3. desempate para evitar inestabilidad → por ID
-                return a.Id < b.Id; // usa lo que tengas como identificador único
+    // merges staged operations into their machine queues, each goes in front of the first queued
+    // operation of a less urgent job so the rest of the queue keeps its order
+    void flushStagedOperations()
+    {
+        for (auto& [mid, staged] : staged_ops_)
+        {
+            auto& m = state_.machines[mid];
+            // a packed table moves as one block, ranked by its most urgent member
+            auto rankOf = [this](const std::vector<OperationID>& block)
+            {
+                JobOrderKey rank = operationRank(block.front());
+                for (OperationID opid : block) rank = std::min(rank, operationRank(opid));
+                return rank;
             };
+            std::vector<std::pair<JobOrderKey, std::vector<OperationID>>> incoming;
+            for (auto& block : queueBlocks(staged)) incoming.emplace_back(rankOf(block), std::move(block));
+            std::stable_sort(incoming.begin(), incoming.end(),
+                             [](const auto& a, const auto& b) { return a.first < b.first; });
+
+            std::vector<OperationID> queued;
+            for (; !m.operations.empty(); m.operations.pop()) queued.push_back(m.operations.front());
+            std::queue<OperationID> merged;
+            size_t next = 0;
+            auto push = [&merged](const std::vector<OperationID>& block)
+            {
+                for (OperationID opid : block) merged.push(opid);
+            };
+            for (const auto& block : queueBlocks(queued))
+            {
+                const JobOrderKey rank = rankOf(block);
+                while (next < incoming.size() && incoming[next].first < rank) push(incoming[next++].second);
+                push(block);
+            }
+            while (next < incoming.size()) push(incoming[next++].second);
+            m.operations = std::move(merged);
+            if (m.status != MachineState::error) m.status = MachineState::running;
+        }
+        staged_ops_.clear();
+    }
 
-            // Crear vector temporal ordenable
-            std::vector<Job> ordered;
+    // the operations in queue order with the members of each packed table gathered behind the first one, every
+    // block is a table or a single operation
+    std::vector<std::vector<OperationID>> queueBlocks(const std::vector<OperationID>& ops) const
+    {
+        std::vector<std::vector<OperationID>> blocks;
+        std::unordered_map<int, size_t> table_block;
+        for (OperationID opid : ops)
+        {
+            auto itop = state_.operations.find(opid);
+            const int table = itop != state_.operations.end() ? itop->second.fixtureGroup : -1;
+            if (table >= 0)
+            {
+                auto [it, inserted] = table_block.emplace(table, blocks.size());
+                if (!inserted)
+                {
+                    blocks[it->second].push_back(opid);
+                    continue;
+                }
+            }
+            blocks.push_back({opid});
+        }
+        return blocks;
+    }
 
-            ordered.reserve(state_.jobs.size());
+    // operations still to plan, open jobs in priority order then parts without a job, routing order inside a part
+    std::vector<OperationID> planningOrder() const
+    {
+        std::vector<OperationID> order;
+        std::unordered_set<PartID> seen;
+        auto addPart = [&](PartID partId)
+        {
+            if (!seen.insert(partId).second) return;
+            auto itpart = state_.parts.find(partId);
+            if (itpart == state_.parts.end()) return;
+            for (OperationID opid : itpart->second.operations)
+            {
+                const auto& op = state_.operations.at(opid);
+                if (op.state == State::pending && !op.completed) order.push_back(opid);
+            }
+        };
+        for (const auto& key : job_order_)
+        {
+            for (const auto& [partId, qty] : state_.jobs.at(key.jobId).parts) addPart(partId);
+        }
+        for (const auto& [partId, remaining] : part_remaining_ops_)
+        {
+            if (!part_jobs_.count(partId)) addPart(partId);
+        }
+        return order;
+    }
 
-            for (auto& [id, job] : state_.jobs)
-                ordered.push_back(job);
+    // operation in progress and its remaining seconds per machine
+    std::unordered_map<MachineID, std::pair<OperationID, double>> runningOperations() const
+    {
+        std::unordered_map<MachineID, std::pair<OperationID, double>> running;
+        for (const auto& [mid, opid] : machine_current_op_)
+        {
+            auto itrem = machine_remaining_time_.find(mid);
+            running[mid] = {opid, itrem != machine_remaining_time_.end() ? std::max(0.0, itrem->second) : 0.0};
+        }
+        return running;
+    }
 
-            std::sort(ordered.begin(), ordered.end(), cmp);
+    // full replan of everything not started yet, computed on a copy of the state
+    void launchReoptimization()
+    {
+        reoptimize_wanted_ = false;
+        auto running = runningOperations();
+        std::optional<OptiProSimple::HorizonOptions> horizon;
+        std::vector<OperationID> order;
+        if (rolling_horizon_)
+        {
+            horizon = horizon_options_;
+            order = planningOrder();
+        }
+        reoptimize_future_ = std::async(std::launch::async,
+                                        [snapshot = state_, running = std::move(running),
+                                            options = schedule_options_, backend = backend_options_, horizon,
+                                            order = std::move(order)]()
+                                        {
+                                            auto result = horizon
+                                                              ? OptiProSimple::rolling_horizon_schedule(
+                                                                  snapshot, order, running, *horizon, options)
+                                                              : reoptimize(snapshot, running, options, backend);
+                                            result.origin = snapshot.time;
+                                            return result;
+                                        });
+    }
+
+    // running operations are fixed at their end and keep their machine busy until then
+    static OptiProSimple::HorizonSchedule reoptimize(
+        const ProductionState& snapshot,
+        const std::unordered_map<MachineID, std::pair<OperationID, double>>& running,
+        const OptiProSimple::ScheduleOptions& options, const OptiProSimple::BackendOptions& backend = {})
+    {
+        OptiProSimple::HorizonSchedule result;
+        result.schedule = OptiProSimple::replan_state(snapshot, running, options, backend);
+        result.window_size = result.schedule.size();
+        return result;
+    }
 
-            for (auto& job : ordered)
+    // applies a finished background replan, reconciled against the work still pending now: operations that
+    // started or finished meanwhile are dropped, pending ones it places go to its machine whether or not they
+    // were queued, and pending queued ones it leaves out go back to their machine
+    // a seeded engine waits for it instead so the plan lands on the same simulated step every run
+    void collectReoptimization()
+    {
+        if (!reoptimize_future_.valid()) return;
+        if (!deterministic_ && reoptimize_future_.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return;
+        auto planned = reoptimize_future_.get();
+        const auto& schedule = planned.schedule;
+
+        std::unordered_map<OperationID, MachineID> queued;
+        for (auto& [mid, m] : state_.machines)
+        {
+            auto q = m.operations;
+            for (; !q.empty(); q.pop()) queued[q.front()] = mid;
+        }
+        std::unordered_set<OperationID> started;
+        for (const auto& [mid, opid] : machine_current_op_) started.insert(opid);
+
+        std::vector<OptiProSimple::ScheduledOp> kept;
+        std::vector<OperationID> unplaced;
+        kept.reserve(schedule.size());
+        horizon_window_.clear();
+        for (size_t i = 0; i < schedule.size(); ++i)
+        {
+            const auto& s = schedule[i];
+            auto itop = state_.operations.find(s.op_id);
+            if (itop == state_.operations.end() || itop->second.completed || itop->second.state != State::pending ||
+                started.count(s.op_id))
+                continue;
+            if (state_.machines[s.machine_id].status == MachineState::error)
             {
-                for (auto part : job.parts)
-                {
-                    part.first; //ID DE PARTES ORDENADA
-                    for (auto ope : state_.operations)
-                    {
-                        if (part.first == ope.second.partId && ope.second.state == State::pending)
-                        {
-                            //Con mi lista ordenada de jobs, asignar las operaciones a las maquinas
-                            assignOperationToMachine(ope.second.id);
-                            ope.second.state = State::pending;
-                            if (job.state == State::pending)
-                            {
-                                job.state = State::running;
-                            }
-                        }
-                    }
-                }
+                // stopped since, a queued op stays where it is and one never queued is dispatched
+                if (!queued.count(s.op_id)) unplaced.push_back(s.op_id);
+                continue;
+            }
+            kept.push_back(s);
+            queued.erase(s.op_id);
+            dispatched_ops_.insert(s.op_id);
+            if (rolling_horizon_ && i < planned.window_size) horizon_window_.insert(s.op_id);
+        }
+        horizon_window_size_ = horizon_window_.size();
+        horizon_elapsed_ = 0.0;
+        setCurrentSchedule(kept, planned.origin);
+        applySchedule(kept);
+
+        // whatever the replan didnt place goes back to its machine
+        staging_ = true;
+        for (const auto& [opid, mid] : queued) pushToMachine(state_.machines[mid], opid);
+        for (OperationID opid : unplaced) assignOperationToMachine(opid);
+        staging_ = false;
+        flushStagedOperations();
+    }
+
+    // the plan as the machines will run it: the operation in progress for its remaining time, then the queue
+    // back to back with nominal durations, times count from now
+    std::vector<OptiProSimple::ScheduledOp> executionPlan() const
+    {
+        std::vector<OptiProSimple::ScheduledOp> plan;
+        for (const auto& [mid, m] : state_.machines)
+        {
+            double t = 0.0;
+            auto itcur = machine_current_op_.find(mid);
+            if (itcur != machine_current_op_.end())
+            {
+                auto itrem = machine_remaining_time_.find(mid);
+                t = itrem != machine_remaining_time_.end() ? std::max(0.0, itrem->second) : 0.0;
+                plan.push_back(OptiProSimple::ScheduledOp{itcur->second, mid, 0.0, t});
+            }
+            for (auto q = m.operations; !q.empty(); q.pop())
+            {
+                const double d = queuedWork(state_.operations.at(q.front()));
+                plan.push_back(OptiProSimple::ScheduledOp{q.front(), mid, t, t + d});
+                t += d;
             }
-            jobs_size_mem = state_.jobs.size();
+        }
+        return plan;
+    }
+
+    // replaces the published plan and counts how much it changed from the previous one
+    // plans count from the state time they were made at (origin), the published one is on the simulation clock
+    void setCurrentSchedule(std::vector<OptiProSimple::ScheduledOp> schedule, double origin)
+    {
+        for (auto& s : schedule)
+        {
+            s.start += origin;
+            s.end += origin;
+        }
+        std::lock_guard<std::mutex> lk(schedule_mutex_);
+        const auto diff = OptiProSimple::diff_schedules(current_schedule_, schedule);
+        plan_stability_.last = diff;
+        ++plan_stability_.replans;
+        plan_stability_.moved += diff.moved;
+        plan_stability_.resequenced += diff.resequenced;
+        current_schedule_ = std::move(schedule);
+        schedule_index_.clear();
+        schedule_machine_index_.clear();
+        for (size_t i = 0; i < current_schedule_.size(); ++i)
+        {
+            schedule_index_[current_schedule_[i].op_id] = i;
+            schedule_machine_index_[current_schedule_[i].machine_id].push_back(i);
         }
     }
 
@@ -546,6 +1404,25 @@ private:
         StateSnapshot snapshot;
         snapshot.productionState = state_;
 
+        if (tool_forecast_dirty_) forecastToolExpiry();
+        snapshot.toolExpiries = tool_expiries_;
+        snapshot.toolReplacements = tool_replacements_;
+
+        int queued = 0;
+        double largestQueue = 0.0;
+        for (const auto& [mid, m] : state_.machines)
+        {
+            queued += static_cast<int>(m.operations.size());
+            largestQueue = std::max(largestQueue, balancer_.load(mid));
+        }
+        snapshot.kpis = kpi_.snapshot(queued, largestQueue);
+        {
+            std::lock_guard<std::mutex> lk(schedule_mutex_);
+            snapshot.planStability = plan_stability_;
+        }
+        snapshot.robustness = robustness_;
+        snapshot.whatIf = what_if_results_;
+
         // per-machine runtime
         for (const auto& [mid, m] : state_.machines)
         {
@@ -573,14 +1450,19 @@ private:
         //creates a part with its associated operations
         //belives that the operations are correctly initialized
         part.id = nextPartId_++;
-        state_.parts[part.id] = std::move(part);
-        for (auto& op : part.operations)
+        auto& stored = state_.parts[part.id];
+        stored = std::move(part);
+        const auto indices = std::move(stored.operations);
+        stored.operations.clear();
+        for (auto& op : indices)
         {
-            operations[op].partId = part.id;
+            operations[op].id = nextOperationId_;
+            operations[op].partId = stored.id;
             state_.operations[nextOperationId_] = std::move(operations[op]);
-            state_.parts[part.id].operations.push_back(nextOperationId_);
+            stored.operations.push_back(nextOperationId_);
             nextOperationId_++;
         }
+        registerPart(stored);
     }
 
     void addTool(Tool tool)
@@ -601,46 +1483,74 @@ private:
 
     void generateRandomJobs(const int minJobs, const int maxJobs)
     {
-        static thread_local std::mt19937 rng{std::random_device{}()};
+        auto& rng = rng_.jobs;
         std::uniform_int_distribution<int> jobs(minJobs, maxJobs);
 
         const int numJobs = jobs(rng);
+        //candidate parts and machines are collected once for the whole call
+        const auto pools = buildGeneratorPools(state_.parts, state_.machines, state_.tools, routing_config_);
         for (int i = 1; i <= numJobs; ++i)
         {
             auto [job , newParts, newOperations, lastJobId, lastPartId,lLastOpId]
                 = GenerateRandomJob(rng, numJobs,
-                                    "", nextJobId_, nextPartId_, nextOperationId_, state_.parts,
-                                    state_.tools, state_.machines);
-
-            state_.jobs[job.jobId] = std::move(job);
-
-            for (auto& part : newParts)
-            {
-                state_.parts[part.first] = std::move(part.second);
-            }
+                                    "", nextJobId_, nextPartId_, nextOperationId_, pools);
 
             for (auto& op : newOperations)
             {
                 state_.operations[op.first] = std::move(op.second);
             }
 
-            // Assign created operations to machines
-            for (const auto& op : newOperations)
+            for (auto& part : newParts)
             {
-                assignOperationToMachine(op.first);
+                registerPart(part.second);
+                state_.parts[part.first] = std::move(part.second);
             }
 
+            assignDueDate(job);
+            auto& stored = state_.jobs[job.jobId];
+            stored = std::move(job);
+            registerJob(stored);
+
             nextOperationId_ = lLastOpId;
             nextPartId_ = lastPartId;
             nextJobId_ = lastJobId;
         }
+        // operations are dispatched by the optimizer from the new jobs list
+    }
+
+    // generates count jobs in parallel and merges them into the state in one pass
+    void generateBulkJobs(int count)
+    {
+        if (count <= 0) return;
+        const auto pools = buildGeneratorPools(state_.parts, state_.machines, state_.tools, routing_config_);
+        const uint64_t batchSeed = rng_.jobs();
+        auto batch = generateRandomJobsBulk(batchSeed, count, nextJobId_, nextPartId_, nextOperationId_, pools);
+
+        // ids are increasing so every insert is hinted at the end of the maps
+        for (auto& op : batch.operations)
+        {
+            nextOperationId_ = op.id + 1;
+            state_.operations.emplace_hint(state_.operations.end(), op.id, std::move(op));
+        }
+        for (auto& part : batch.parts)
+        {
+            nextPartId_ = part.id + 1;
+            registerPart(part);
+            state_.parts.emplace_hint(state_.parts.end(), part.id, std::move(part));
+        }
+        for (auto& job : batch.jobs)
+        {
+            nextJobId_ = job.jobId + 1;
+            assignDueDate(job);
+            auto stored = state_.jobs.emplace_hint(state_.jobs.end(), job.jobId, std::move(job));
+            registerJob(stored->second);
+        }
     }
 
     void generateRandomMachines(int count)
     {
         if (count <= 0) return;
-        // generate a rng device
-        static thread_local std::mt19937 rng{std::random_device{}()};
+        auto& rng = rng_.machines;
 
         for (int i = 0; i < count; ++i)
         {
@@ -655,6 +1565,7 @@ private:
             machine.sizeClass = machineSizeClass;
             machine.workEnvelope = randomWorkEnvelope(rng, machineSizeClass);
             machine.machineSpecs = randomMachineSpecs(rng);
+            machine.magazineCapacity = defaultMagazineCapacity(machineSizeClass);
 
             //selecting random tools from the tool library of the factory
             //map vector to tools
@@ -665,8 +1576,9 @@ private:
             }
             //shuffle the vector to get a random list
             std::shuffle(to_select.begin(), to_select.end(), rng);
-            //select a random ammount of tools from the library
-            std::uniform_int_distribution<int> distribution(1, state_.tools.size() - 1);
+            //select a random ammount of tools from the library that fits in the magazine
+            const int maxTools = std::min<int>(machine.magazineCapacity, static_cast<int>(to_select.size()) - 1);
+            std::uniform_int_distribution<int> distribution(std::min(1, maxTools), std::max(0, maxTools));
             int numToSelect = distribution(rng);
             //push those tools into the machine tool lib and assigning them a internal tool id
             for (int j = 0; j < numToSelect; ++j)
@@ -674,13 +1586,17 @@ private:
                 machine.tools.insert({j, to_select[j]});
             }
             //push the machine back to the list of machines
-            state_.machines[machine.id] = std::move(machine);
+            kpi_.machineAdded(machine.id);
+            const MachineID mid = machine.id;
+            state_.machines[mid] = std::move(machine);
+            scheduleFailure(mid);
         }
+        balancer_dirty_ = true;
     }
 
     void generateRandomTools(int count)
     {
-        static thread_local std::mt19937 rng{std::random_device{}()};
+        auto& rng = rng_.tools;
         for (int i = 0; i < count; ++i)
         {
             state_.tools[nextToolId_] = std::move(generateRandomTool(nextToolId_, rng));
@@ -690,71 +1606,151 @@ private:
 
     void GenerateRandomPart()
     {
-        static thread_local std::mt19937 rng{std::random_device{}()};
+        auto& rng = rng_.parts;
         //std::cout << "generating part" << std::endl;
         //std::cout << "part id" << nextPartId_ << " opid:" << nextOperationId_ << std::endl;
-        auto [part, ops, lastOpId] = GenerateRandomPartWithOperations(rng, nextPartId_, nextOperationId_, state_.tools,
-                                                                      state_.machines);
+        auto [part, ops, lastOpId] = GenerateRandomPartWithOperations(
+            rng, nextPartId_, nextOperationId_,
+            buildGeneratorPools({}, state_.machines, state_.tools, routing_config_));
         nextOperationId_ = lastOpId;
-        state_.parts[part.id] = std::move(part);
         for (auto& op : ops)
         {
             state_.operations[op.id] = std::move(op);
         }
+        registerPart(part);
+        state_.parts[part.id] = std::move(part);
 
         ++nextPartId_;
         //std::cout << "after part generation" << std::endl;
         //std::cout << "part id" << nextPartId_ << " opid:" << nextOperationId_ << std::endl;
     }
 
-    // Assign a single operation to the first compatible machine (simple heuristic)
-    void assignOperationToMachine(OperationID opid)
+    // sends new operations to machine queues, packing compatible ones onto shared tables when enabled
+    void dispatchOperations(const std::vector<OperationID>& ops)
     {
-        auto itop = state_.operations.find(opid);
-        if (itop == state_.operations.end()) return;
-        const auto& op = itop->second;
-        for (auto& [mid, m] : state_.machines)
+        if (!schedule_options_.pack_fixtures)
         {
-            if (m.machineType != op.requiredMachine) continue;
-            bool ok = true;
-            for (const auto& spec : op.requiredMachineSpces)
+            for (OperationID opid : ops) assignOperationToMachine(opid);
+            return;
+        }
+
+        auto loads = OptiProSimple::pack_fixtures(ops, state_, nextFixtureId_);
+        for (auto& load : loads)
+        {
+            nextFixtureId_ = load.id + 1;
+            for (const auto& placement : load.placements)
+            {
+                state_.operations[placement.op_id].fixtureGroup = load.id;
+            }
+            // the whole table goes to one machine so the members run back to back
+            const MachineID mid = assignOperationToMachine(load.placements.front().op_id, &load.extent);
+            if (mid < 0)
             {
-                if (m.machineSpecs.find(spec) == m.machineSpecs.end())
+                // no machine free to take the table, fall back to single parts
+                for (const auto& placement : load.placements)
                 {
-                    ok = false;
-                    break;
+                    state_.operations[placement.op_id].fixtureGroup = -1;
                 }
+                continue;
             }
-            if (!ok) continue;
-
-            if (m.status != MachineState::error)
+            for (size_t i = 1; i < load.placements.size(); ++i)
             {
-                m.status = MachineState::running;
-                m.operations.push(opid);
+                pushToMachine(state_.machines[mid], load.placements[i].op_id);
             }
+            fixture_loads_[load.id] = std::move(load);
+        }
+        for (OperationID opid : ops)
+        {
+            if (state_.operations[opid].fixtureGroup < 0) assignOperationToMachine(opid);
+        }
+    }
+
+    // rebuilt lazily after machines are added
+    LoadBalancer& loadBalancer()
+    {
+        if (balancer_dirty_)
+        {
+            balancer_.build(state_.machines);
+            balancer_dirty_ = false;
+        }
+        return balancer_;
+    }
+
+    void pushToMachine(Machine& m, OperationID opid)
+    {
+        dispatched_ops_.insert(opid);
+        if (staging_)
+        {
+            staged_ops_[m.id].push_back(opid);
+            loadBalancer().add(m.id, queuedWork(state_.operations[opid]));
             return;
         }
+        m.status = MachineState::running;
+        m.operations.push(opid);
+        loadBalancer().add(m.id, queuedWork(state_.operations[opid]));
+        tool_forecast_dirty_ = true;
+    }
+
+    // queued work from the machine queues and running operations, after queues are rebuilt wholesale
+    void recountQueuedWork()
+    {
+        for (const auto& [mid, m] : state_.machines) recountQueuedWork(mid);
+    }
+
+    void recountQueuedWork(MachineID mid)
+    {
+        const auto& m = state_.machines[mid];
+        double work = 0.0;
+        auto q = m.operations;
+        for (; !q.empty(); q.pop()) work += queuedWork(state_.operations[q.front()]);
+        auto itcur = machine_current_op_.find(mid);
+        if (itcur != machine_current_op_.end()) work += queuedWork(state_.operations[itcur->second]);
+        loadBalancer().set(mid, work);
+    }
+
+    // Assign a single operation to the compatible machine with the least queued work,
+    // tools it would have to load count as extra work
+    // minEnvelope restricts the choice to machines whose table holds a packed load
+    MachineID assignOperationToMachine(OperationID opid, const SizeXYZ* minEnvelope = nullptr)
+    {
+        auto itop = state_.operations.find(opid);
+        if (itop == state_.operations.end()) return -1;
+        const auto& op = itop->second;
+        const SizeXYZ* partSize = OptiProSimple::part_size_of(state_, op);
+        const MachineID mid = loadBalancer().pick(op, [&](MachineID id)
+        {
+            const Machine& m = state_.machines[id];
+            if (m.status == MachineState::error || !OptiProSimple::machine_can_run(m, op)) return false;
+            if (partSize && !OptiProSimple::part_fits_envelope(*partSize, m.workEnvelope)) return false;
+            return !minEnvelope || OptiProSimple::envelope_holds(m.workEnvelope, *minEnvelope);
+        }, [&](MachineID id)
+        {
+            return magazineFor(state_.machines[id]).missing(op) * schedule_options_.tool_change_time;
+        });
+        if (mid < 0) return -1;
+        pushToMachine(state_.machines[mid], opid);
+        return mid;
     }
 
     void GenerateRandomParts(const int amount)
     {
-        //creates rng number and adds the parts and operations to the state
-        static thread_local std::mt19937 rng{std::random_device{}()};
+        //uses the parts stream and adds the parts and operations to the state
+        auto& rng = rng_.parts;
         auto [parts , operations, lastPartId, lastOpId] = generateRandomParts(
-            rng, amount, nextPartId_, nextOperationId_, state_.tools, state_.machines);
-        for (auto& [partId,part] : parts)
-        {
-            state_.parts[partId] = std::move(part);
-        }
+            rng, amount, nextPartId_, nextOperationId_, state_.tools, state_.machines, routing_config_);
+        std::vector<OperationID> created;
         for (auto& [opId,operation] : operations)
         {
+            created.push_back(opId);
             state_.operations[opId] = std::move(operation);
         }
-        // assign generated operations to machines
-        for (const auto& [opId, operation] : operations)
+        for (auto& [partId,part] : parts)
         {
-            assignOperationToMachine(opId);
+            registerPart(part);
+            state_.parts[partId] = std::move(part);
         }
+        // assign generated operations to machines
+        dispatchOperations(created);
         //updates the operation and part ids
         nextOperationId_ = lastOpId;
         nextPartId_ = lastPartId;
@@ -765,12 +1761,67 @@ private:
     std::chrono::milliseconds tickPeriod_;
 
     ProductionState state_;
+    // reverse indices for completion, a part finishes when its counter hits zero and a job when all its parts did
+    std::unordered_map<PartID, std::vector<int>> part_jobs_;
+    std::unordered_map<PartID, int> part_remaining_ops_;
+    std::unordered_map<int, int> job_remaining_parts_;
+    // operation before each one in its part routing, dropped once the operation completes
+    std::unordered_map<OperationID, OperationID> routing_pred_;
+    // queues with nothing ready to start, looked at again when one of the operations they wait on completes or the
+    // queue changes
+    struct BlockedQueue
+    {
+        size_t size;
+        OperationID front;
+        OperationID back;
+    };
+    std::unordered_map<MachineID, BlockedQueue> blocked_queues_;
+    std::unordered_map<OperationID, std::vector<MachineID>> machines_waiting_on_;
+    // persistent priority index of the open jobs and the jobs not planned yet
+    std::set<JobOrderKey> job_order_;
+    std::unordered_map<int, JobOrderKey> job_keys_;
+    std::vector<int> new_jobs_;
+    // operations already sent to a machine queue, staged ones are merged by priority on flush
+    std::unordered_set<OperationID> dispatched_ops_;
+    std::unordered_map<MachineID, std::vector<OperationID>> staged_ops_;
+    bool staging_ = false;
+    // background full replan
+    std::future<OptiProSimple::HorizonSchedule> reoptimize_future_;
+    bool reoptimize_wanted_ = false;
+    OptiProSimple::BackendOptions backend_options_;
+    // rolling horizon, the optimized window of the last roll and how far the clock moved since
+    bool rolling_horizon_ = false;
+    OptiProSimple::HorizonOptions horizon_options_;
+    std::unordered_set<OperationID> horizon_window_;
+    size_t horizon_window_size_ = 0;
+    double horizon_elapsed_ = 0.0;
+    // queued work per machine for dispatch
+    LoadBalancer balancer_;
+    bool balancer_dirty_ = true;
+
+    // schedule quality indicators
+    KpiEngine kpi_;
+    // packed tables by fixture group id
+    std::map<int, OptiProSimple::FixtureLoad> fixture_loads_;
+    int nextFixtureId_ = 0;
+
+    // per subsystem random streams derived from one master seed
+    RngStreams rng_;
+    // seeded runs collect background replans at a fixed step instead of whenever they finish
+    bool deterministic_;
+    // routings, quantities and setup families used by the part generators
+    RoutingConfig routing_config_;
 
     // Optimizer runtime structures
-    OptiProSimple::Graph opt_graph_;
-    std::vector<OptiProSimple::OptMachine> opt_machines_;
     std::vector<OptiProSimple::ScheduledOp> current_schedule_;
+    // positions in current_schedule_ by operation and by machine
+    std::unordered_map<OperationID, size_t> schedule_index_;
+    std::unordered_map<MachineID, std::vector<size_t>> schedule_machine_index_;
+    // churn between consecutive plans
+    PlanStability plan_stability_;
     std::mutex schedule_mutex_;
+    OptiProSimple::ScheduleOptions schedule_options_;
+    OptiProSimple::RepairOptions repair_options_;
 
     ConcurrentQueue<CommandVariant> commands_;
     ConcurrentQueue<StateSnapshot> updates_;
@@ -779,8 +1830,25 @@ private:
     // Runtime execution tracking
     std::unordered_map<MachineID, OperationID> machine_current_op_;
     std::unordered_map<MachineID, double> machine_remaining_time_;
-    std::unordered_map<ToolID, double> tool_wear_accum_;
+    std::unordered_map<MachineID, int> machine_last_family_;
+    std::unordered_map<MachineID, int> machine_last_fixture_;
+    std::unordered_map<MachineID, ToolMagazine> magazines_;
+    std::unordered_map<ToolID, double> tool_wear_accum_; // wear not yet taken off currentToolLife
+    std::vector<ToolExpiry> tool_expiries_;
+    bool tool_forecast_dirty_ = false;
+    int tool_replacements_ = 0;
+    double tool_replacement_time_ = 30.0;
     std::unordered_set<MachineID> failed_handled_;
+    // mtbf / mttr per machine kind and the sampled failures and repairs
+    ReliabilityModel reliability_ = ReliabilityModel::defaults();
+    FailureEvents failure_events_;
+    // monte carlo evaluation of the running plan
+    std::future<RobustnessReport> robustness_future_;
+    std::optional<RobustnessReport> robustness_;
+    // forked scenarios and the last results
+    OptiProSimple::ScenarioSandbox sandbox_;
+    std::vector<WhatIfResult> what_if_results_;
+    size_t max_what_if_results_ = 8;
 
     int nextMachineId_;
     int nextJobId_;
@@ -789,4 +1857,6 @@ private:
     int nextToolId_;
 
     double timer_multiplier_ = 1.0;
+    // longest simulated step, a fast clock is cut into these
+    double max_step_seconds_ = 5.0;
 };
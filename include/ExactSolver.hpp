@@ -0,0 +1,358 @@
+//
+// Branch and bound for the flexible job shop of a small cell
+//
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "Optimizer.hpp"
+
+namespace OptiProSimple
+{
+    struct ExactOptions
+    {
+        // the solver only takes cells up to this size, bigger ones stay with the list scheduler
+        size_t max_operations = 200;
+        size_t max_machines = 10;
+        // wall clock budget, the best schedule found so far is returned when it runs out
+        double time_limit_seconds = 2.0;
+    };
+
+    struct ExactResult
+    {
+        std::vector<ScheduledOp> schedule;
+        double makespan = 0.0;
+        double lower_bound = 0.0;
+        bool proven_optimal = false;
+        uint64_t nodes = 0;
+    };
+
+    // depth first branch and bound over active schedules
+    // a node picks the (operation, machine) pair with the earliest completion C and branches on every ready pair
+    // that could start before C, children are tried in completion order so the first dive is a greedy schedule
+    // durations are setupTime + machineTime * quantity, the model has no sequence dependent setups
+    class ExactSolver
+    {
+    public:
+        ExactSolver(Graph& g, const std::vector<OptMachine>& machines, const ProductionState& state,
+                    double start_time, const std::unordered_map<int, double>& completed_node_end,
+                    const ExactOptions& options)
+            : options_(options)
+        {
+            const EligibilityIndex eligibility(state.machines);
+            std::unordered_map<MachineID, int> machine_index;
+            for (const auto& m : machines)
+            {
+                if (!m.available) continue;
+                machine_index[m.machine_id] = static_cast<int>(machine_ids_.size());
+                machine_ids_.push_back(m.machine_id);
+                initial_avail_.push_back(std::max(m.available_time, start_time));
+            }
+            // machines are bits of a 64 bit mask, a bigger cell is never solved so nothing else is built
+            if (machine_ids_.size() > max_mask_machines || machine_ids_.size() > options_.max_machines) return;
+
+            std::vector<int> node_to_op(g.nodes.size(), -1);
+            for (int i = 0; i < static_cast<int>(g.nodes.size()); ++i)
+            {
+                if (completed_node_end.count(i)) continue;
+                node_to_op[i] = static_cast<int>(ops_.size());
+                Op op;
+                op.id = g.nodes[i]->opid;
+                const auto& data = state.operations.at(op.id);
+                op.duration = static_cast<double>(data.setupTime) + static_cast<double>(data.machineTime) * data.
+                    quantity;
+                eligibility.for_each_eligible(data, part_size_of(state, data), [&](const Machine& m)
+                {
+                    auto it = machine_index.find(m.id);
+                    if (it != machine_index.end()) op.machines |= uint64_t{1} << it->second;
+                });
+                ops_.push_back(op);
+            }
+            for (int i = 0; i < static_cast<int>(g.nodes.size()); ++i)
+            {
+                const int o = node_to_op[i];
+                if (o < 0) continue;
+                for (int p : g.nodes[i]->pred)
+                {
+                    if (node_to_op[p] >= 0) ops_[o].preds.push_back(node_to_op[p]);
+                    else
+                    {
+                        auto it = completed_node_end.find(p);
+                        if (it != completed_node_end.end()) ops_[o].release = std::max(ops_[o].release, it->second);
+                    }
+                }
+                for (int s : g.nodes[i]->succ) if (node_to_op[s] >= 0) ops_[o].succs.push_back(node_to_op[s]);
+            }
+            // operations nothing can run, and everything after them, are left out like the list scheduler does
+            for (int o = 0; o < static_cast<int>(ops_.size()); ++o) if (ops_[o].machines == 0) drop(o);
+
+            // tail: shortest chain of work that still has to follow each operation
+            tail_.assign(ops_.size(), 0.0);
+            std::vector<int> topo = topological_order();
+            for (auto it = topo.rbegin(); it != topo.rend(); ++it)
+            {
+                for (int s : ops_[*it].succs)
+                {
+                    if (!ops_[s].dropped) tail_[*it] = std::max(tail_[*it], ops_[s].duration + tail_[s]);
+                }
+            }
+            for (const auto& op : ops_)
+            {
+                if (!op.dropped && std::find(masks_.begin(), masks_.end(), op.machines) == masks_.end())
+                    masks_.push_back(op.machines);
+            }
+        }
+
+        static constexpr size_t max_mask_machines = 64;
+
+        bool fits() const
+        {
+            return ops_.size() <= options_.max_operations && machine_ids_.size() <= options_.max_machines &&
+                machine_ids_.size() <= max_mask_machines;
+        }
+
+        // the same limits counted on the graph, so a cell too big is turned away before the model is built
+        static bool fits(const Graph& g, const std::vector<OptMachine>& machines,
+                         const std::unordered_map<int, double>& completed_node_end, const ExactOptions& options)
+        {
+            size_t available = 0;
+            for (const auto& m : machines) available += m.available;
+            size_t open = 0;
+            for (int i = 0; i < static_cast<int>(g.nodes.size()); ++i) open += !completed_node_end.count(i);
+            return open <= options.max_operations && available <= options.max_machines &&
+                available <= max_mask_machines;
+        }
+
+        ExactResult solve()
+        {
+            ExactResult result;
+            deadline_ = std::chrono::steady_clock::now() +
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(options_.time_limit_seconds));
+
+            avail_ = initial_avail_;
+            end_.assign(ops_.size(), -1.0);
+            assigned_.assign(ops_.size(), -1);
+            missing_preds_.assign(ops_.size(), 0);
+            remaining_ = 0;
+            for (int o = 0; o < static_cast<int>(ops_.size()); ++o)
+            {
+                if (ops_[o].dropped) continue;
+                ++remaining_;
+                missing_preds_[o] = static_cast<int>(ops_[o].preds.size());
+            }
+
+            root_bound_ = lower_bound();
+            best_makespan_ = 1e300;
+            timed_out_ = false;
+            branch(0.0);
+
+            result.nodes = nodes_;
+            result.lower_bound = root_bound_;
+            result.proven_optimal = !timed_out_ && best_makespan_ < 1e300;
+            result.makespan = best_makespan_ < 1e300 ? best_makespan_ : 0.0;
+            for (int o = 0; o < static_cast<int>(ops_.size()); ++o)
+            {
+                if (best_assigned_.empty() || best_assigned_[o] < 0) continue;
+                result.schedule.push_back(ScheduledOp{
+                    ops_[o].id, machine_ids_[best_assigned_[o]], best_end_[o] - ops_[o].duration, best_end_[o]
+                });
+            }
+            std::sort(result.schedule.begin(), result.schedule.end(),
+                      [](const ScheduledOp& a, const ScheduledOp& b) { return a.start < b.start; });
+            return result;
+        }
+
+    private:
+        struct Op
+        {
+            OperationID id = -1;
+            double duration = 0.0;
+            double release = 0.0;
+            uint64_t machines = 0;
+            std::vector<int> preds;
+            std::vector<int> succs;
+            bool dropped = false;
+        };
+
+        struct Candidate
+        {
+            int op;
+            int machine;
+            double start;
+            double end;
+        };
+
+        void drop(int o)
+        {
+            if (ops_[o].dropped) return;
+            ops_[o].dropped = true;
+            for (int s : ops_[o].succs) drop(s);
+        }
+
+        std::vector<int> topological_order() const
+        {
+            std::vector<int> indeg(ops_.size(), 0), order;
+            for (const auto& op : ops_) for (int s : op.succs) ++indeg[s];
+            for (int o = 0; o < static_cast<int>(ops_.size()); ++o) if (indeg[o] == 0) order.push_back(o);
+            for (size_t i = 0; i < order.size(); ++i)
+            {
+                for (int s : ops_[order[i]].succs) if (--indeg[s] == 0) order.push_back(s);
+            }
+            return order;
+        }
+
+        double ready_time(int o) const
+        {
+            double t = ops_[o].release;
+            for (int p : ops_[o].preds) t = std::max(t, end_[p]);
+            return t;
+        }
+
+        // max of the chain bound (earliest start + own work + tail) and, for every distinct eligible set,
+        // the average finish of its machines if they had to absorb all operations restricted to them
+        double lower_bound() const
+        {
+            double bound = 0.0;
+            std::vector<double> head(ops_.size(), 0.0);
+            for (int o : topo_cache())
+            {
+                if (ops_[o].dropped || assigned_[o] >= 0) continue;
+                double h = ops_[o].release;
+                double earliest_machine = 1e300;
+                for (int m = 0; m < static_cast<int>(avail_.size()); ++m)
+                {
+                    if (ops_[o].machines >> m & 1u) earliest_machine = std::min(earliest_machine, avail_[m]);
+                }
+                h = std::max(h, earliest_machine);
+                for (int p : ops_[o].preds) h = std::max(h, assigned_[p] >= 0 ? end_[p] : head[p] + ops_[p].duration);
+                head[o] = h;
+                bound = std::max(bound, h + ops_[o].duration + tail_[o]);
+            }
+            for (uint64_t mask : masks_)
+            {
+                double work = 0.0;
+                int count = 0;
+                for (int m = 0; m < static_cast<int>(avail_.size()); ++m)
+                {
+                    if (mask >> m & 1u)
+                    {
+                        work += avail_[m];
+                        ++count;
+                    }
+                }
+                bool any = false;
+                for (int o = 0; o < static_cast<int>(ops_.size()); ++o)
+                {
+                    if (ops_[o].dropped || assigned_[o] >= 0 || (ops_[o].machines & ~mask)) continue;
+                    work += ops_[o].duration;
+                    any = true;
+                }
+                if (any && count > 0) bound = std::max(bound, work / count);
+            }
+            return bound;
+        }
+
+        const std::vector<int>& topo_cache() const
+        {
+            if (topo_.empty()) topo_ = topological_order();
+            return topo_;
+        }
+
+        void branch(double makespan)
+        {
+            ++nodes_;
+            if ((nodes_ & 1023) == 0 && std::chrono::steady_clock::now() > deadline_) timed_out_ = true;
+            if (timed_out_) return;
+
+            if (remaining_ == 0)
+            {
+                if (makespan < best_makespan_)
+                {
+                    best_makespan_ = makespan;
+                    best_end_ = end_;
+                    best_assigned_ = assigned_;
+                }
+                return;
+            }
+            if (std::max(makespan, lower_bound()) >= best_makespan_) return;
+
+            // earliest completion over every ready pair
+            std::vector<Candidate> ready;
+            double c_star = 1e300;
+            for (int o = 0; o < static_cast<int>(ops_.size()); ++o)
+            {
+                if (ops_[o].dropped || assigned_[o] >= 0 || missing_preds_[o] > 0) continue;
+                const double r = ready_time(o);
+                for (int m = 0; m < static_cast<int>(avail_.size()); ++m)
+                {
+                    if (!(ops_[o].machines >> m & 1u)) continue;
+                    const double start = std::max(r, avail_[m]);
+                    ready.push_back(Candidate{o, m, start, start + ops_[o].duration});
+                    c_star = std::min(c_star, start + ops_[o].duration);
+                }
+            }
+            // only pairs that could start before the earliest completion keep the schedule active
+            ready.erase(std::remove_if(ready.begin(), ready.end(),
+                                       [&](const Candidate& c) { return c.start >= c_star; }), ready.end());
+            std::sort(ready.begin(), ready.end(), [](const Candidate& a, const Candidate& b)
+            {
+                return a.end != b.end ? a.end < b.end : a.op < b.op;
+            });
+
+            for (const auto& c : ready)
+            {
+                const double previous_avail = avail_[c.machine];
+                avail_[c.machine] = c.end;
+                end_[c.op] = c.end;
+                assigned_[c.op] = c.machine;
+                for (int s : ops_[c.op].succs) --missing_preds_[s];
+                --remaining_;
+
+                branch(std::max(makespan, c.end));
+
+                ++remaining_;
+                for (int s : ops_[c.op].succs) ++missing_preds_[s];
+                assigned_[c.op] = -1;
+                end_[c.op] = -1.0;
+                avail_[c.machine] = previous_avail;
+                if (timed_out_ || best_makespan_ <= root_bound_) return;
+            }
+        }
+
+        ExactOptions options_;
+        std::vector<Op> ops_;
+        std::vector<MachineID> machine_ids_;
+        std::vector<double> initial_avail_;
+        std::vector<double> tail_;
+        std::vector<uint64_t> masks_;
+        mutable std::vector<int> topo_;
+
+        std::vector<double> avail_;
+        std::vector<double> end_;
+        std::vector<int> assigned_;
+        std::vector<int> missing_preds_;
+        int remaining_ = 0;
+
+        double root_bound_ = 0.0;
+        double best_makespan_ = 1e300;
+        std::vector<double> best_end_;
+        std::vector<int> best_assigned_;
+        uint64_t nodes_ = 0;
+        bool timed_out_ = false;
+        std::chrono::steady_clock::time_point deadline_;
+    };
+
+    inline ExactResult solve_exact(Graph& g, const std::vector<OptMachine>& machines, const ProductionState& state,
+                                   double start_time = 0.0,
+                                   const std::unordered_map<int, double>& completed_node_end = {},
+                                   const ExactOptions& options = {})
+    {
+        if (!ExactSolver::fits(g, machines, completed_node_end, options)) return ExactResult{};
+        ExactSolver solver(g, machines, state, start_time, completed_node_end, options);
+        return solver.solve();
+    }
+}
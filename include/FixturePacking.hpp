@@ -0,0 +1,210 @@
+//
+// Packs several small parts onto one machine table so they share a single setup
+//
+#pragma once
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include "Optimizer.hpp"
+
+namespace OptiProSimple
+{
+    // position of one operation's part on the table, x/y in mm from the table origin
+    struct FixturePlacement
+    {
+        OperationID op_id = -1;
+        float x = 0.f;
+        float y = 0.f;
+        float width = 0.f;
+        float depth = 0.f;
+        bool rotated = false;
+    };
+
+    // operations clamped together on one table, they run back to back with one setup
+    struct FixtureLoad
+    {
+        int id = -1;
+        MachineType machine_type = MachineType::DEFAULT;
+        SizeXYZ table{}; // envelope the load was packed against
+        SizeXYZ extent{}; // bounding box actually used, a machine needs at least this envelope
+        std::vector<FixturePlacement> placements;
+        uint32_t setup_time = 0; // shared setup, the longest of the members
+        uint32_t machine_time = 0; // sum of machineTime * quantity of the members
+    };
+
+    // 2D guillotine packer over the table, the Z axis is only checked against the envelope height
+    // free space is kept as disjoint rectangles, each placement splits its rectangle in two
+    class GuillotinePacker
+    {
+    public:
+        GuillotinePacker(const SizeXYZ& table, float spacing)
+            : height_(table.Z), spacing_(spacing)
+        {
+            free_.push_back(Rect{0.f, 0.f, table.X, table.Y});
+        }
+
+        // best short side fit over the free rectangles, trying both orientations
+        bool insert(OperationID op, const SizeXYZ& size, FixturePlacement& out)
+        {
+            if (size.Z > height_) return false;
+            const float w = size.X + spacing_;
+            const float d = size.Y + spacing_;
+
+            int best = -1;
+            bool bestRotated = false;
+            float bestFit = 0.f;
+            for (int i = 0; i < static_cast<int>(free_.size()); ++i)
+            {
+                const auto& r = free_[i];
+                for (bool rotated : {false, true})
+                {
+                    const float pw = rotated ? d : w;
+                    const float pd = rotated ? w : d;
+                    if (pw > r.w || pd > r.d) continue;
+                    const float fit = std::min(r.w - pw, r.d - pd);
+                    if (best < 0 || fit < bestFit)
+                    {
+                        best = i;
+                        bestRotated = rotated;
+                        bestFit = fit;
+                    }
+                }
+            }
+            if (best < 0) return false;
+
+            const Rect r = free_[best];
+            const float pw = bestRotated ? d : w;
+            const float pd = bestRotated ? w : d;
+            out = FixturePlacement{op, r.x, r.y, pw, pd, bestRotated};
+
+            // shorter leftover axis split keeps the larger leftover rectangle as big as possible
+            Rect right, top;
+            if (r.w - pw < r.d - pd)
+            {
+                right = Rect{r.x + pw, r.y, r.w - pw, pd};
+                top = Rect{r.x, r.y + pd, r.w, r.d - pd};
+            }
+            else
+            {
+                right = Rect{r.x + pw, r.y, r.w - pw, r.d};
+                top = Rect{r.x, r.y + pd, pw, r.d - pd};
+            }
+            free_.erase(free_.begin() + best);
+            if (right.w > 0.f && right.d > 0.f) free_.push_back(right);
+            if (top.w > 0.f && top.d > 0.f) free_.push_back(top);
+            return true;
+        }
+
+    private:
+        struct Rect
+        {
+            float x, y, w, d;
+        };
+
+        std::vector<Rect> free_;
+        float height_;
+        float spacing_;
+    };
+
+    // groups operations that need the same setup (machine type, specs, family and tools) and packs
+    // each group onto the largest table that can run it, only loads with two or more parts are returned
+    inline std::vector<FixtureLoad> pack_fixtures(const std::vector<OperationID>& ops, const ProductionState& state,
+                                                  int first_load_id, float spacing = 10.f)
+    {
+        using GroupKey = std::tuple<uint64_t, std::set<MachineSpecs>, int>;
+        std::map<GroupKey, std::vector<OperationID>> groups;
+        for (OperationID opid : ops)
+        {
+            auto itop = state.operations.find(opid);
+            if (itop == state.operations.end()) continue;
+            const auto& op = itop->second;
+            if (op.fixtureGroup >= 0 || op.state != State::pending) continue;
+            groups[GroupKey{setup_signature(op), op.requiredMachineSpces, op.setupFamily}].push_back(opid);
+        }
+
+        std::vector<FixtureLoad> loads;
+        int next_id = first_load_id;
+        for (auto& [key, members] : groups)
+        {
+            if (members.size() < 2) continue;
+            const auto& first = state.operations.at(members.front());
+
+            // largest table among the machines able to run the group
+            const Machine* table_machine = nullptr;
+            for (const auto& [mid, m] : state.machines)
+            {
+                if (!machine_can_run(m, first)) continue;
+                if (!table_machine || m.workEnvelope.X * m.workEnvelope.Y >
+                    table_machine->workEnvelope.X * table_machine->workEnvelope.Y)
+                {
+                    table_machine = &m;
+                }
+            }
+            if (!table_machine) continue;
+
+            // biggest footprints first
+            auto footprint = [&](OperationID opid)
+            {
+                const auto& size = state.parts.at(state.operations.at(opid).partId).partSize;
+                return size.X * size.Y;
+            };
+            std::sort(members.begin(), members.end(),
+                      [&](OperationID a, OperationID b) { return footprint(a) > footprint(b); });
+
+            std::vector<FixtureLoad> open;
+            std::vector<GuillotinePacker> packers;
+            for (OperationID opid : members)
+            {
+                const auto& op = state.operations.at(opid);
+                auto itpart = state.parts.find(op.partId);
+                if (itpart == state.parts.end()) continue;
+                const auto& size = itpart->second.partSize;
+
+                FixturePlacement placement;
+                size_t target = open.size();
+                for (size_t i = 0; i < open.size(); ++i)
+                {
+                    if (packers[i].insert(opid, size, placement))
+                    {
+                        target = i;
+                        break;
+                    }
+                }
+                if (target == open.size())
+                {
+                    GuillotinePacker packer(table_machine->workEnvelope, spacing);
+                    if (!packer.insert(opid, size, placement)) continue; // part doesnt fit even alone
+                    FixtureLoad load;
+                    load.machine_type = op.requiredMachine;
+                    load.table = table_machine->workEnvelope;
+                    open.push_back(std::move(load));
+                    packers.push_back(std::move(packer));
+                }
+
+                auto& load = open[target];
+                load.placements.push_back(placement);
+                load.extent.X = std::max(load.extent.X, placement.x + placement.width);
+                load.extent.Y = std::max(load.extent.Y, placement.y + placement.depth);
+                load.extent.Z = std::max(load.extent.Z, size.Z);
+                load.setup_time = std::max(load.setup_time, op.setupTime);
+                load.machine_time += op.machineTime * op.quantity;
+            }
+
+            for (auto& load : open)
+            {
+                if (load.placements.size() < 2) continue;
+                load.id = next_id++;
+                loads.push_back(std::move(load));
+            }
+        }
+        return loads;
+    }
+
+    // machine envelope can hold the packed load as laid out
+    inline bool envelope_holds(const SizeXYZ& envelope, const SizeXYZ& extent)
+    {
+        return extent.X <= envelope.X && extent.Y <= envelope.Y && extent.Z <= envelope.Z;
+    }
+}
@@ -2,11 +2,71 @@
 // Created by fjasis on 11/16/25.
 //
 #pragma once
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cmath>
 #include <random>
+#include <set>
+#include <thread>
+#include <vector>
 
 #include "types.hpp"
 
+//identifiers for the independent random streams used by the generators
+enum class RngStreamId : uint32_t
+{
+    jobs = 1,
+    machines,
+    tools,
+    parts,
+    failures
+};
+
+//derives a stream from the master seed, the same seed and stream always give the same sequence
+inline std::mt19937 makeRngStream(uint64_t seed, RngStreamId stream)
+{
+    std::seed_seq seq{
+        static_cast<uint32_t>(seed & 0xffffffffu),
+        static_cast<uint32_t>(seed >> 32),
+        static_cast<uint32_t>(stream)
+    };
+    return std::mt19937(seq);
+}
+
+//one random stream per subsystem so generating machines doesnt change the jobs or failures sequences
+struct RngStreams
+{
+    uint64_t seed = 0;
+    std::mt19937 jobs;
+    std::mt19937 machines;
+    std::mt19937 tools;
+    std::mt19937 parts;
+    std::mt19937 failures;
+
+    explicit RngStreams(uint64_t masterSeed)
+    {
+        reseed(masterSeed);
+    }
+
+    void reseed(uint64_t masterSeed)
+    {
+        seed = masterSeed;
+        jobs = makeRngStream(seed, RngStreamId::jobs);
+        machines = makeRngStream(seed, RngStreamId::machines);
+        tools = makeRngStream(seed, RngStreamId::tools);
+        parts = makeRngStream(seed, RngStreamId::parts);
+        failures = makeRngStream(seed, RngStreamId::failures);
+    }
+};
+
+//non deterministic seed for runs that didnt configure one
+inline uint64_t randomSeed()
+{
+    std::random_device rd;
+    return (static_cast<uint64_t>(rd()) << 32) | rd();
+}
+
 inline MachineType randomMachineType(std::mt19937& rng)
 {
     constexpr std::array<MachineType, 7> allTypes = {
@@ -136,9 +196,57 @@ inline Tool generateRandomTool(int toolId, std::mt19937& rng)
     return tool;
 }
 
+//compatible tool ids for every machine type, built once so operations dont scan the library
+struct ToolIndex
+{
+    std::array<std::vector<ToolID>, static_cast<size_t>(MachineType::count)> byMachine;
+    size_t librarySize = 0;
+
+    const std::vector<ToolID>& compatible(MachineType type) const
+    {
+        return byMachine[static_cast<size_t>(type)];
+    }
+};
+
+inline void addToToolIndex(ToolIndex& index, const Tool& tool)
+{
+    for (auto type : tool.compatibleMachines)
+    {
+        if (type == MachineType::count) continue;
+        index.byMachine[static_cast<size_t>(type)].push_back(tool.toolId);
+    }
+    ++index.librarySize;
+}
+
+inline ToolIndex buildToolIndex(const std::map<ToolID, Tool>& toolLib)
+{
+    ToolIndex index;
+    for (const auto& [id, tool] : toolLib)
+    {
+        addToToolIndex(index, tool);
+    }
+    return index;
+}
+
+//floyd's algorithm, picks k distinct values of [0, n) using k random draws
+//k is small (a handful of tools) so the linear search in out is cheaper than a set
+inline void sampleWithoutReplacement(std::mt19937& rng, int n, int k, std::vector<int>& out)
+{
+    out.clear();
+    if (k <= 0 || n <= 0) return;
+    k = std::min(k, n);
+    for (int j = n - k; j < n; ++j)
+    {
+        std::uniform_int_distribution<int> dist(0, j);
+        int t = dist(rng);
+        if (std::find(out.begin(), out.end(), t) != out.end()) t = j;
+        out.push_back(t);
+    }
+}
+
 inline std::pair<std::vector<Operation>, OperationID> generateRandomOperations(std::mt19937& rng, PartID part_id,
                                                                                int startOpId,
-                                                                               const std::map<ToolID, Tool>& toolLib)
+                                                                               const ToolIndex& toolIndex)
 {
     std::vector<Operation> operations;
 
@@ -147,11 +255,7 @@ inline std::pair<std::vector<Operation>, OperationID> generateRandomOperations(s
     // std::uniform_int_distribution<int> opCountDist(1,5);
     // int numOperations = opCountDist(rng);
     int numOperations = 1;
-    std::vector<Tool> availableTools;
-    for (const auto& [id, tool] : toolLib)
-    {
-        availableTools.push_back(tool);
-    }
+    std::vector<int> picked;
     //start generating operations
     //std::cout << "number of ops to generate" << numOperations << std::endl;
     for (int i = 0; i < numOperations; ++i)
@@ -161,28 +265,23 @@ inline std::pair<std::vector<Operation>, OperationID> generateRandomOperations(s
         ++baseOpId;
         operation.partId = part_id;
         //random Op quantity (1-100)tbd
-        //TODO implement bin packing on a random machine size and see if theres an avaialable machine
         //TODO check the ammount of parts needed for said job to see if its worthed
         //std::uniform_int_distribution<uint32_t> qtyDist(1,50);
         //operation.quantity = qtyDist(rng);
         operation.quantity = 1;
 
         //select random tools needed of the same type of machine
-        std::uniform_int_distribution<int> toolCountDist(1, std::min(4, static_cast<int>(availableTools.size())));
-        const int numTools = toolCountDist(rng);
-
-        std::vector<Tool> shuffledTools = availableTools;
-        std::shuffle(shuffledTools.begin(), shuffledTools.end(), rng);
-
         auto machineType = randomMachineType(rng);
         operation.requiredMachine = machineType;
-        int addedTools = 0;
-        for (const auto& tool : shuffledTools)
+        const auto& compatibleTools = toolIndex.compatible(machineType);
+        if (toolIndex.librarySize > 0)
         {
-            if (tool.compatibleMachines.count(operation.requiredMachine) && addedTools < numTools)
+            std::uniform_int_distribution<int> toolCountDist(1, std::min(4, static_cast<int>(toolIndex.librarySize)));
+            const int numTools = toolCountDist(rng);
+            sampleWithoutReplacement(rng, static_cast<int>(compatibleTools.size()), numTools, picked);
+            for (int idx : picked)
             {
-                operation.tools.insert(tool.toolId);
-                ++addedTools;
+                operation.tools.insert(compatibleTools[idx]);
             }
         }
         //set up time
@@ -214,40 +313,341 @@ inline std::pair<std::vector<Operation>, OperationID> generateRandomOperations(s
     return {operations, baseOpId};
 }
 
+inline std::pair<std::vector<Operation>, OperationID> generateRandomOperations(std::mt19937& rng, PartID part_id,
+                                                                               int startOpId,
+                                                                               const std::map<ToolID, Tool>& toolLib)
+{
+    return generateRandomOperations(rng, part_id, startOpId, buildToolIndex(toolLib));
+}
+
+//one step of a routing, optional steps are skipped with 1 - probability
+struct RoutingStep
+{
+    MachineType machine;
+    float probability = 1.0f;
+};
+
+//ordered list of machine types a part visits, e.g. saw -> lathe -> 5 axis -> deburr
+struct RoutingTemplate
+{
+    std::string_view name;
+    std::vector<RoutingStep> steps;
+};
+
+enum class QuantityDistribution
+{
+    fixed,
+    uniform,
+    logUniform //mostly small batches with a long tail of big ones
+};
+
+//configures the part generator, multiOperation = false keeps the old single random operation
+struct RoutingConfig
+{
+    bool multiOperation = true;
+    int maxOperations = 6;
+    QuantityDistribution quantityDistribution = QuantityDistribution::logUniform;
+    uint32_t minQuantity = 1;
+    uint32_t maxQuantity = 50;
+    int setupFamilies = 8;
+    float familyToolProbability = 0.8f; //chance an op uses its family tool set instead of random tools
+    std::vector<RoutingTemplate> templates;
+    //generated jobs are due after slack * their longest routing, 0 leaves them without a due date
+    float minDueSlack = 1.5f;
+    float maxDueSlack = 4.0f;
+};
+
+//the shops standard routings, blanks are cut on the laser (our saw) and deburring runs on a 3 axis
+inline std::vector<RoutingTemplate> defaultRoutingTemplates()
+{
+    return {
+        {
+            "prismatic", {
+                {MachineType::LASER_CUTTER}, {MachineType::VMC_3AXIS}, {MachineType::VMC_5AXIS, 0.6f},
+                {MachineType::VMC_3AXIS, 0.7f}
+            }
+        },
+        {
+            "turned", {
+                {MachineType::LASER_CUTTER}, {MachineType::LATHE}, {MachineType::TURN_MILL, 0.5f},
+                {MachineType::VMC_5AXIS, 0.3f}, {MachineType::VMC_3AXIS, 0.7f}
+            }
+        },
+        {"sheet", {{MachineType::LASER_CUTTER}, {MachineType::PRESS_BREAK}, {MachineType::VMC_3AXIS, 0.4f}}},
+        {"indexed", {{MachineType::VMC_3AXIS}, {MachineType::VMC_4AXIS}, {MachineType::VMC_3AXIS, 0.7f}}},
+    };
+}
+
+inline float randomDueSlack(std::mt19937& rng, const RoutingConfig& config)
+{
+    if (config.maxDueSlack <= 0.0f) return 0.0f;
+    const float lo = std::max(0.0f, std::min(config.minDueSlack, config.maxDueSlack));
+    return std::uniform_real_distribution<float>(lo, config.maxDueSlack)(rng);
+}
+
+//seconds one part takes through its routing with nominal setups and nothing waiting
+inline double routingWork(const Part& part, const std::map<OperationID, Operation>& operations)
+{
+    double work = 0.0;
+    for (OperationID opid : part.operations)
+    {
+        auto it = operations.find(opid);
+        if (it == operations.end()) continue;
+        work += static_cast<double>(it->second.setupTime) +
+            static_cast<double>(it->second.machineTime) * it->second.quantity;
+    }
+    return work;
+}
+
+inline uint32_t randomQuantity(std::mt19937& rng, const RoutingConfig& config)
+{
+    const uint32_t lo = std::max<uint32_t>(1, config.minQuantity);
+    const uint32_t hi = std::max(lo, config.maxQuantity);
+    switch (config.quantityDistribution)
+    {
+    case QuantityDistribution::uniform:
+        return std::uniform_int_distribution<uint32_t>(lo, hi)(rng);
+    case QuantityDistribution::logUniform:
+        {
+            std::uniform_real_distribution<double> logDist(std::log(lo), std::log(hi + 1.0));
+            return std::min(hi, static_cast<uint32_t>(std::exp(logDist(rng))));
+        }
+    default:
+        return lo;
+    }
+}
+
+//tool set shared by every operation of a setup family on a machine type
+//derived from its own seed so it is the same for every part without storing it
+inline void familyTools(const ToolIndex& toolIndex, int family, MachineType type, std::set<ToolID>& out)
+{
+    const auto& compatibleTools = toolIndex.compatible(type);
+    std::seed_seq seq{static_cast<uint32_t>(family), static_cast<uint32_t>(type)};
+    std::mt19937 familyRng(seq);
+    std::uniform_int_distribution<int> toolCountDist(1, 4);
+    std::vector<int> picked;
+    sampleWithoutReplacement(familyRng, static_cast<int>(compatibleTools.size()), toolCountDist(familyRng), picked);
+    for (int idx : picked)
+    {
+        out.insert(compatibleTools[idx]);
+    }
+}
+
+//generates the operations of a part following a random routing template
+//steps whose machine type has no machine in the shop are skipped when machineTypes is not empty
+inline std::pair<std::vector<Operation>, OperationID> generateRoutedOperations(std::mt19937& rng, PartID part_id,
+    int startOpId, const ToolIndex& toolIndex, const RoutingConfig& config,
+    const std::array<bool, static_cast<size_t>(MachineType::count)>& machineTypes, bool anyMachine)
+{
+    std::vector<Operation> operations;
+    static const auto defaults = defaultRoutingTemplates();
+    const auto& templates = config.templates.empty() ? defaults : config.templates;
+
+    std::vector<MachineType> route;
+    const auto& routing = getRandomElement(templates, rng);
+    std::uniform_real_distribution<float> stepDist(0.f, 1.f);
+    for (const auto& step : routing.steps)
+    {
+        if (static_cast<int>(route.size()) >= config.maxOperations) break;
+        if (step.probability < 1.0f && stepDist(rng) >= step.probability) continue;
+        if (anyMachine && !machineTypes[static_cast<size_t>(step.machine)]) continue;
+        route.push_back(step.machine);
+    }
+    if (route.empty())
+    {
+        route.push_back(randomMachineType(rng));
+    }
+
+    //every operation of the part runs the same batch
+    const uint32_t quantity = randomQuantity(rng, config);
+    std::uniform_int_distribution<int> familyDist(0, std::max(1, config.setupFamilies) - 1);
+    std::uniform_real_distribution<float> familyToolDist(0.f, 1.f);
+    std::uniform_int_distribution<int> setupDist(5, 60);
+    std::uniform_int_distribution<int> machineTimeDist(1, 120);
+    std::uniform_int_distribution<int> specsCountDist(0, 2);
+    const std::array<MachineSpecs, 3> allSpecs = {
+        MachineSpecs::highspeed_spindle,
+        MachineSpecs::double_turret,
+        MachineSpecs::long_tools
+    };
+    std::vector<int> picked;
+
+    int opId = startOpId;
+    operations.reserve(route.size());
+    for (auto machineType : route)
+    {
+        Operation operation;
+        operation.id = opId++;
+        operation.partId = part_id;
+        operation.quantity = quantity;
+        operation.requiredMachine = machineType;
+
+        if (config.setupFamilies > 0)
+        {
+            operation.setupFamily = familyDist(rng);
+        }
+        if (operation.setupFamily >= 0 && familyToolDist(rng) < config.familyToolProbability)
+        {
+            familyTools(toolIndex, operation.setupFamily, machineType, operation.tools);
+        }
+        else if (toolIndex.librarySize > 0)
+        {
+            const auto& compatibleTools = toolIndex.compatible(machineType);
+            std::uniform_int_distribution<int> toolCountDist(1, std::min(4, static_cast<int>(toolIndex.librarySize)));
+            sampleWithoutReplacement(rng, static_cast<int>(compatibleTools.size()), toolCountDist(rng), picked);
+            for (int idx : picked)
+            {
+                operation.tools.insert(compatibleTools[idx]);
+            }
+        }
+
+        operation.setupTime = setupDist(rng);
+        operation.machineTime = machineTimeDist(rng);
+        operation.totalTime = operation.setupTime + (operation.machineTime * operation.quantity);
+
+        const int specCount = specsCountDist(rng);
+        for (int j = 0; j < specCount; ++j)
+        {
+            operation.requiredMachineSpces.insert(allSpecs[j]);
+        }
+        operations.push_back(std::move(operation));
+    }
+    return {operations, opId};
+}
+
+//candidate pools computed once per generation call instead of once per part
+struct GeneratorPools
+{
+    std::vector<PartID> existingParts;
+    std::vector<std::pair<MachineSizeClass, SizeXYZ>> machineSizes; //size class and work envelope of each machine
+    std::array<bool, static_cast<size_t>(MachineType::count)> machineTypes{}; //types present in the shop
+    //specs and work envelope of every machine of each type
+    std::array<std::vector<std::pair<std::set<MachineSpecs>, SizeXYZ>>, static_cast<size_t>(MachineType::count)>
+    machinesByType;
+    ToolIndex tools;
+    RoutingConfig routing;
+};
+
+inline GeneratorPools buildGeneratorPools(const std::map<PartID, Part>& parts,
+                                          const std::map<MachineID, Machine>& machines,
+                                          const std::map<ToolID, Tool>& toolLib,
+                                          const RoutingConfig& routing = {})
+{
+    GeneratorPools pools;
+    pools.tools = buildToolIndex(toolLib);
+    pools.routing = routing;
+    pools.existingParts.reserve(parts.size());
+    for (const auto& [partId, part] : parts)
+    {
+        pools.existingParts.push_back(partId);
+    }
+    pools.machineSizes.reserve(machines.size());
+    for (const auto& [machineId, machine] : machines)
+    {
+        pools.machineSizes.emplace_back(machine.sizeClass, machine.workEnvelope);
+        pools.machineTypes[static_cast<size_t>(machine.machineType)] = true;
+        pools.machinesByType[static_cast<size_t>(machine.machineType)].emplace_back(machine.machineSpecs,
+                                                                                    machine.workEnvelope);
+    }
+    return pools;
+}
+
+//shrink the part until it fits the envelope, turning it on the table first if that is enough
+inline void clampToEnvelope(SizeXYZ& size, const SizeXYZ& envelope)
+{
+    size.Z = std::min(size.Z, envelope.Z);
+    if (size.X <= envelope.X && size.Y <= envelope.Y) return;
+    if (size.X <= envelope.Y && size.Y <= envelope.X) return;
+    //line up the long sides before cutting
+    if ((size.X > size.Y) != (envelope.X > envelope.Y)) std::swap(size.X, size.Y);
+    size.X = std::min(size.X, envelope.X);
+    size.Y = std::min(size.Y, envelope.Y);
+}
+
+//keeps only the specs some machine of the op type has all of, then shrinks the part to the biggest table among
+//the machines of that type with those specs, so at least one machine can run the op
+inline void fitToMachines(SizeXYZ& partSize, Operation& op, const GeneratorPools& pools)
+{
+    const auto& candidates = pools.machinesByType[static_cast<size_t>(op.requiredMachine)];
+    if (candidates.empty()) return;
+    auto shared = [&](const std::set<MachineSpecs>& specs)
+    {
+        size_t n = 0;
+        for (auto spec : op.requiredMachineSpces) n += specs.count(spec);
+        return n;
+    };
+    const std::set<MachineSpecs>* closest = nullptr;
+    size_t closestShared = 0;
+    for (const auto& [specs, envelope] : candidates)
+    {
+        const size_t n = shared(specs);
+        if (!closest || n > closestShared)
+        {
+            closest = &specs;
+            closestShared = n;
+        }
+    }
+    if (closestShared < op.requiredMachineSpces.size())
+    {
+        for (auto it = op.requiredMachineSpces.begin(); it != op.requiredMachineSpces.end();)
+        {
+            it = closest->count(*it) ? std::next(it) : op.requiredMachineSpces.erase(it);
+        }
+    }
+
+    SizeXYZ largest{};
+    for (const auto& [specs, envelope] : candidates)
+    {
+        if (shared(specs) < op.requiredMachineSpces.size()) continue;
+        if (envelope.X * envelope.Y > largest.X * largest.Y) largest = envelope;
+    }
+    if (largest.X > 0.f) clampToEnvelope(partSize, largest);
+}
+
 inline std::tuple<Part, std::vector<Operation>, int> GenerateRandomPartWithOperations(std::mt19937& rng, PartID partId,
-    int startOpId, const std::map<ToolID, Tool>& toolLib, const std::map<MachineID, Machine>& machines)
+    int startOpId, const GeneratorPools& pools)
 {
     Part part;
     part.id = partId;
 
-    //convert map to vector to shuffle machines
-    std::vector<Machine> availableMachines;
-    for (const auto& [machineId_, machine_] : machines)
+    if (!pools.machineSizes.empty())
     {
-        availableMachines.push_back(machine_);
+        //pick a random machine and use its size class to get the random size
+        const auto& [sizeClass, envelope] = getRandomElement(pools.machineSizes, rng);
+        //generate random work envelope then check if the part is larger than the machine and change the value if it is
+        auto size = randomWorkEnvelope(rng, sizeClass);
+        if (size.X > envelope.X) size.X = envelope.X;
+        if (size.Y > envelope.Y) size.Y = envelope.Y;
+        if (size.Z > envelope.Z) size.Z = envelope.Z;
+        part.partSize = size;
+    }
+    else
+    {
+        part.partSize = randomWorkEnvelope(rng, randomMachineSizeClass(rng));
     }
-    std::shuffle(availableMachines.begin(), availableMachines.end(), rng);
-    //get first machine from the shuffle and use its size class to get the random size
-    const auto machine = availableMachines.front();
-    //generate random work envelope then check if the part is larger than the machine and change the value if it is
-    auto size = randomWorkEnvelope(rng, machine.sizeClass);
-    if (size.X > machine.workEnvelope.X) size.X = machine.workEnvelope.X;
-    if (size.Y > machine.workEnvelope.Y) size.Y = machine.workEnvelope.Y;
-    if (size.Z > machine.workEnvelope.Z) size.Z = machine.workEnvelope.Z;
-
-    part.partSize = size;
     //generate the ammount of operations needed for said part
-    auto [operations, lastOPId] = generateRandomOperations(rng, partId, startOpId, toolLib);
+    auto [operations, lastOPId] = pools.routing.multiOperation
+                                      ? generateRoutedOperations(rng, partId, startOpId, pools.tools, pools.routing,
+                                                                 pools.machineTypes, !pools.machineSizes.empty())
+                                      : generateRandomOperations(rng, partId, startOpId, pools.tools);
     part.baseMachineTime = 0;
-    for (const auto& op : operations)
+    for (auto& op : operations)
     {
         part.operations.push_back(op.id);
         part.baseMachineTime += op.totalTime;
+        //every step of the routing needs at least one machine with its specs the part fits on
+        fitToMachines(part.partSize, op, pools);
     }
 
     return {part, operations, lastOPId};
 }
 
+inline std::tuple<Part, std::vector<Operation>, int> GenerateRandomPartWithOperations(std::mt19937& rng, PartID partId,
+    int startOpId, const std::map<ToolID, Tool>& toolLib, const std::map<MachineID, Machine>& machines)
+{
+    return GenerateRandomPartWithOperations(rng, partId, startOpId, buildGeneratorPools({}, machines, toolLib));
+}
+
 inline std::pair<ToolLib, int> generateToolLibrary(std::mt19937& rng, int numTools, ToolID baseToolId)
 {
     ToolLib toolLib;
@@ -264,10 +664,11 @@ inline std::pair<ToolLib, int> generateToolLibrary(std::mt19937& rng, int numToo
 inline std::tuple<std::map<PartID, Part>, std::map<OperationID, Operation>, int, int> generateRandomParts(
     std::mt19937& rng,
     int numParts, int startPartId, int startOpId, const std::map<ToolID, Tool>& toolLib,
-    const std::map<MachineID, Machine>& machines)
+    const std::map<MachineID, Machine>& machines, const RoutingConfig& routing = {})
 {
     std::map<PartID, Part> parts;
     std::map<OperationID, Operation> operations;
+    const auto pools = buildGeneratorPools({}, machines, toolLib, routing);
 
     int currentOpId = startOpId;
 
@@ -275,7 +676,7 @@ inline std::tuple<std::map<PartID, Part>, std::map<OperationID, Operation>, int,
     {
         PartID partId = startPartId;
         auto [part, ops , lastOpId] = GenerateRandomPartWithOperations(rng, partId,
-                                                                       startPartId, toolLib, machines);
+                                                                       currentOpId, pools);
 
         parts[partId] = part;
         for (const auto& op : ops)
@@ -285,28 +686,24 @@ inline std::tuple<std::map<PartID, Part>, std::map<OperationID, Operation>, int,
         currentOpId = lastOpId;
         ++startPartId;
     }
-    return {parts, operations, startPartId, startOpId};
+    return {parts, operations, startPartId, currentOpId};
 }
 
 //generates a random job, and returns a job, map of new parts and new ops, the updated jobid, partid and opid
+//existing parts are taken from the pools so the caller builds them once for many jobs
 inline std::tuple<Job, std::map<PartID, Part>, std::map<OperationID, Operation>, int, int, int> GenerateRandomJob(
     std::mt19937& rng,
     int numJobs, const std::string& jobNameId, const int nextJobId
-    , int nextPartId, int nextOpId, const std::map<PartID, Part>& parts, const std::map<ToolID, Tool>& toolLib,
-    const std::map<MachineID, Machine>& machines)
+    , int nextPartId, int nextOpId, const GeneratorPools& pools)
 {
     Job job;
     std::map<PartID, Part> newParts;
     std::map<OperationID, Operation> newOperations;
-    std::vector<PartID> availableParts;
+    const auto& availableParts = pools.existingParts;
     float newPartProbability = 1.0f;
     int newOpId = nextOpId;
     int newPartId = nextPartId;
 
-    for (auto const& [partId , part] : parts)
-    {
-        availableParts.push_back(part.id);
-    }
     //assing id
     job.jobId = nextJobId;
     //assign job priority
@@ -315,7 +712,7 @@ inline std::tuple<Job, std::map<PartID, Part>, std::map<OperationID, Operation>,
     job.createdTime = std::chrono::system_clock::now();
 
     job.startedTime = std::chrono::system_clock::time_point{};
-    job.finishedTime = std::chrono::system_clock::time_point{};
+    job.finishedTime = -1.0;
 
     std::uniform_int_distribution<int> partCountDist(1, 3);
     int numParts = partCountDist(rng);
@@ -328,26 +725,24 @@ inline std::tuple<Job, std::map<PartID, Part>, std::map<OperationID, Operation>,
     {
         PartID partId;
 
-        bool createdNew = false;
-        if (parts.empty() || partDist(rng) < newPartProbability)
+        if (availableParts.empty() || partDist(rng) < newPartProbability)
         {
             partId = newPartId;
             ++newPartId;
             auto [newPart , newOps , lastOpId] = GenerateRandomPartWithOperations(rng,
-                partId, newOpId, toolLib, machines);
+                partId, newOpId, pools);
             //add new parts to the result
-            newParts[partId] = newPart;
-            for (const auto& op : newOps)
+            newParts[partId] = std::move(newPart);
+            for (auto& op : newOps)
             {
-                newOperations[op.id] = op;
+                newOperations[op.id] = std::move(op);
             }
             newOpId = lastOpId;
         }
         else
         {
             //use exising part
-            std::uniform_int_distribution<size_t> partIndexDist(0, parts.size() - 1);
-            partId = availableParts[partIndexDist(rng)];
+            partId = getRandomElement(availableParts, rng);
         }
         //add part id to the jobs part map and its quantity
         uint32_t qty = qtyDist(rng);
@@ -357,3 +752,117 @@ inline std::tuple<Job, std::map<PartID, Part>, std::map<OperationID, Operation>,
 
     return {job, newParts, newOperations, job.jobId + 1, newPartId, newOpId};
 }
+
+//jobs generated by one bulk chunk, kept in vectors so merging is a single sequential pass
+struct JobBatch
+{
+    std::vector<Job> jobs;
+    std::vector<Part> parts;
+    std::vector<Operation> operations;
+};
+
+//number of jobs generated by each independent rng stream in the bulk generator
+inline constexpr int kBulkJobsPerChunk = 1024;
+
+//generates numJobs jobs in parallel and returns them with their final ids
+//each chunk of kBulkJobsPerChunk jobs has its own stream derived from seed, so the result
+//does not depend on the number of threads. chunks number their new parts/ops from the same
+//provisional base and get their reserved id range from a prefix sum once all chunks are done
+inline JobBatch generateRandomJobsBulk(uint64_t seed, int numJobs, int startJobId, int startPartId, int startOpId,
+                                       const GeneratorPools& pools, unsigned threadCount = 0)
+{
+    JobBatch result;
+    if (numJobs <= 0) return result;
+
+    const int numChunks = (numJobs + kBulkJobsPerChunk - 1) / kBulkJobsPerChunk;
+    std::vector<JobBatch> chunks(numChunks);
+
+    auto generateChunk = [&](int chunk)
+    {
+        std::seed_seq seq{
+            static_cast<uint32_t>(seed & 0xffffffffu),
+            static_cast<uint32_t>(seed >> 32),
+            static_cast<uint32_t>(RngStreamId::jobs),
+            static_cast<uint32_t>(chunk)
+        };
+        std::mt19937 rng(seq);
+
+        const int first = chunk * kBulkJobsPerChunk;
+        const int last = std::min(numJobs, first + kBulkJobsPerChunk);
+        auto& batch = chunks[chunk];
+        batch.jobs.reserve(last - first);
+
+        int partId = startPartId;
+        int opId = startOpId;
+        for (int i = first; i < last; ++i)
+        {
+            auto [job, newParts, newOperations, lastJobId, lastPartId, lastOpId] =
+                GenerateRandomJob(rng, numJobs, "", startJobId + i, partId, opId, pools);
+            batch.jobs.push_back(std::move(job));
+            for (auto& [id, part] : newParts) batch.parts.push_back(std::move(part));
+            for (auto& [id, op] : newOperations) batch.operations.push_back(std::move(op));
+            partId = lastPartId;
+            opId = lastOpId;
+        }
+    };
+
+    if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+    threadCount = std::min<unsigned>(threadCount, numChunks);
+
+    std::atomic<int> nextChunk{0};
+    std::vector<std::thread> workers;
+    workers.reserve(threadCount);
+    for (unsigned t = 0; t < threadCount; ++t)
+    {
+        workers.emplace_back([&]
+        {
+            for (int chunk = nextChunk++; chunk < numChunks; chunk = nextChunk++)
+            {
+                generateChunk(chunk);
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+
+    //reserve the id ranges and shift every chunk into its own range while merging
+    size_t totalParts = 0, totalOps = 0;
+    for (const auto& chunk : chunks)
+    {
+        totalParts += chunk.parts.size();
+        totalOps += chunk.operations.size();
+    }
+    result.jobs.reserve(numJobs);
+    result.parts.reserve(totalParts);
+    result.operations.reserve(totalOps);
+
+    int partOffset = 0;
+    int opOffset = 0;
+    for (auto& chunk : chunks)
+    {
+        for (auto& job : chunk.jobs)
+        {
+            std::map<PartID, uint32_t> shifted;
+            for (const auto& [partId, qty] : job.parts)
+            {
+                shifted.emplace_hint(shifted.end(), partId >= startPartId ? partId + partOffset : partId, qty);
+            }
+            job.parts = std::move(shifted);
+            result.jobs.push_back(std::move(job));
+        }
+        for (auto& part : chunk.parts)
+        {
+            part.id += partOffset;
+            for (auto& opId : part.operations) opId += opOffset;
+            result.parts.push_back(std::move(part));
+        }
+        for (auto& op : chunk.operations)
+        {
+            op.id += opOffset;
+            op.partId += partOffset;
+            result.operations.push_back(std::move(op));
+        }
+        partOffset += static_cast<int>(chunk.parts.size());
+        opOffset += static_cast<int>(chunk.operations.size());
+    }
+    return result;
+}
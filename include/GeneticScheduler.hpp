@@ -0,0 +1,440 @@
+//
+// Genetic algorithm backend, operation based chromosomes decoded with the list scheduler placement rule
+//
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Optimizer.hpp"
+
+namespace OptiProSimple
+{
+    struct GeneticOptions
+    {
+        int population = 40;
+        int elite = 2;
+        int tournament = 3;
+        double crossover_rate = 0.9;
+        double mutation_rate = 0.3;
+        // wall clock budget, 0 for only the generation limit
+        double time_limit_seconds = 2.0;
+        // 0 for only the time limit
+        int max_generations = 0;
+        // fitness workers, 0 for one per core
+        unsigned threads = 0;
+        uint64_t seed = 1;
+    };
+
+    struct GeneticResult
+    {
+        std::vector<ScheduledOp> schedule;
+        double makespan = 0.0;
+        double objective = 0.0; // ScheduleOptions::objective of the schedule
+        double initial_objective = 0.0; // list scheduler order, the seed individual
+        int generations = 0;
+    };
+
+    // a chromosome lists a part once per operation left on it, the k-th time a part appears its k-th operation
+    // is placed on the machine giving the earliest completion, the same rule schedule_orders uses
+    // every chromosome is valid for the routing so crossover and mutation never need repair
+    class GeneticScheduler
+    {
+    public:
+        GeneticScheduler(Graph& g, const std::vector<OptMachine>& machines, const ProductionState& state,
+                         double start_time, const std::unordered_map<int, double>& completed_node_end,
+                         const ScheduleOptions& options, const GeneticOptions& genetic)
+            : state_(state), options_(options), genetic_(genetic), base_(machines)
+        {
+            for (auto& m : base_) if (m.available) m.available_time = std::max(m.available_time, start_time);
+            std::unordered_map<MachineID, int> machine_index;
+            for (int i = 0; i < static_cast<int>(base_.size()); ++i) machine_index[base_[i].machine_id] = i;
+            const EligibilityIndex eligibility(state.machines);
+            const auto anchors = options_.stability_penalty > 0.0
+                                     ? queued_machines(state)
+                                     : std::unordered_map<OperationID, MachineID>{};
+
+            // chains of the operations still to plan per part, in precedence order
+            const int n = static_cast<int>(g.nodes.size());
+            std::vector<int> indeg(n, 0), topo;
+            for (int i = 0; i < n; ++i) indeg[i] = static_cast<int>(g.nodes[i]->pred.size());
+            for (int i = 0; i < n; ++i) if (indeg[i] == 0) topo.push_back(i);
+            for (size_t k = 0; k < topo.size(); ++k)
+            {
+                for (int s : g.nodes[topo[k]]->succ) if (--indeg[s] == 0) topo.push_back(s);
+            }
+            std::unordered_map<PartID, int> chain_of;
+            std::unordered_map<int, int> fixture_index;
+            const auto dues = part_due_dates(state);
+            std::vector<char> blocked(n, 0);
+            for (int i : topo)
+            {
+                double release = start_time;
+                bool ready = !blocked[i];
+                for (int p : g.nodes[i]->pred)
+                {
+                    if (blocked[p]) ready = false;
+                    auto it = completed_node_end.find(p);
+                    if (it != completed_node_end.end()) release = std::max(release, it->second);
+                }
+                if (completed_node_end.count(i)) continue;
+
+                Gene gene;
+                gene.op = &state.operations.at(g.nodes[i]->opid);
+                auto itanchor = anchors.find(gene.op->id);
+                if (itanchor != anchors.end()) gene.anchor = itanchor->second;
+                eligibility.for_each_eligible(*gene.op, part_size_of(state, *gene.op), [&](const Machine& m)
+                {
+                    auto it = machine_index.find(m.id);
+                    if (it != machine_index.end() && base_[it->second].available) gene.machines.push_back(it->second);
+                });
+                // nothing can run it, it and everything after it stay unplanned like in schedule_orders
+                if (!ready || gene.machines.empty())
+                {
+                    blocked[i] = 1;
+                    for (int s : g.nodes[i]->succ) blocked[s] = 1;
+                    continue;
+                }
+                if (gene.op->fixtureGroup >= 0)
+                {
+                    gene.fixture = fixture_index.emplace(gene.op->fixtureGroup,
+                                                         static_cast<int>(fixture_index.size())).first->second;
+                }
+                auto [itc, inserted] = chain_of.emplace(gene.op->partId, static_cast<int>(chains_.size()));
+                if (inserted)
+                {
+                    chains_.emplace_back();
+                    chain_release_.push_back(release);
+                    auto itdue = dues.find(gene.op->partId);
+                    chain_due_.push_back(itdue != dues.end() ? itdue->second : DueDate{});
+                }
+                chains_[itc->second].push_back(std::move(gene));
+            }
+            for (int c = 0; c < static_cast<int>(chains_.size()); ++c)
+            {
+                for (size_t k = 0; k < chains_[c].size(); ++k) base_genes_.push_back(c);
+            }
+            fixture_groups_ = static_cast<int>(fixture_index.size());
+        }
+
+        GeneticResult solve()
+        {
+            GeneticResult result;
+            const int length = static_cast<int>(base_genes_.size());
+            if (length == 0) return result;
+            const int population = std::max(2, genetic_.population);
+            const int elite = std::clamp(genetic_.elite, 0, population - 1);
+            const auto deadline = std::chrono::steady_clock::now() +
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(genetic_.time_limit_seconds));
+            std::mt19937_64 rng(genetic_.seed);
+
+            // arena, two generations of chromosomes back to back plus per worker decode state
+            std::vector<int> current(static_cast<size_t>(population) * length);
+            std::vector<int> next(current.size());
+            std::vector<double> fitness(population, 0.0);
+            std::vector<int> ranking(population);
+            std::vector<char> chosen_parts(chains_.size(), 0);
+            unsigned threads = genetic_.threads ? genetic_.threads : std::thread::hardware_concurrency();
+            threads = std::clamp(threads, 1u, static_cast<unsigned>(population));
+            std::vector<Workspace> workspaces(threads);
+            for (auto& ws : workspaces) prepare(ws);
+
+            // first individual follows the list scheduler, the rest are shuffles
+            seed_from_list_order(current.data());
+            for (int i = 1; i < population; ++i)
+            {
+                int* genes = current.data() + static_cast<size_t>(i) * length;
+                std::copy(base_genes_.begin(), base_genes_.end(), genes);
+                std::shuffle(genes, genes + length, rng);
+            }
+
+            FitnessPool pool(threads, [&](unsigned worker, int individual)
+            {
+                fitness[individual] = decode(current.data() + static_cast<size_t>(individual) * length,
+                                             workspaces[worker], nullptr);
+            });
+            pool.run(population);
+            result.initial_objective = fitness[0];
+
+            auto tournament = [&]() -> const int*
+            {
+                std::uniform_int_distribution<int> pick(0, population - 1);
+                int best = pick(rng);
+                for (int t = 1; t < genetic_.tournament; ++t)
+                {
+                    const int other = pick(rng);
+                    if (fitness[other] < fitness[best]) best = other;
+                }
+                return current.data() + static_cast<size_t>(best) * length;
+            };
+            std::uniform_real_distribution<double> unit(0.0, 1.0);
+            std::uniform_int_distribution<int> position(0, length - 1);
+
+            int generation = 0;
+            while ((genetic_.max_generations <= 0 || generation < genetic_.max_generations) &&
+                (genetic_.time_limit_seconds <= 0.0 || std::chrono::steady_clock::now() < deadline))
+            {
+                if (genetic_.max_generations <= 0 && genetic_.time_limit_seconds <= 0.0) break;
+                std::iota(ranking.begin(), ranking.end(), 0);
+                std::sort(ranking.begin(), ranking.end(), [&](int a, int b) { return fitness[a] < fitness[b]; });
+                for (int i = 0; i < elite; ++i)
+                {
+                    const int* src = current.data() + static_cast<size_t>(ranking[i]) * length;
+                    std::copy(src, src + length, next.data() + static_cast<size_t>(i) * length);
+                }
+                for (int i = elite; i < population; ++i)
+                {
+                    int* child = next.data() + static_cast<size_t>(i) * length;
+                    const int* a = tournament();
+                    if (unit(rng) < genetic_.crossover_rate) crossover(a, tournament(), child, chosen_parts, rng);
+                    else std::copy(a, a + length, child);
+                    if (unit(rng) < genetic_.mutation_rate)
+                    {
+                        const int from = position(rng);
+                        const int to = position(rng);
+                        if (unit(rng) < 0.5) std::swap(child[from], child[to]);
+                        else if (from < to) std::rotate(child + from, child + from + 1, child + to + 1);
+                        else std::rotate(child + to, child + from, child + from + 1);
+                    }
+                }
+                std::swap(current, next);
+                pool.run(population);
+                ++generation;
+            }
+
+            const int best = static_cast<int>(std::min_element(fitness.begin(), fitness.end()) - fitness.begin());
+            result.objective = decode(current.data() + static_cast<size_t>(best) * length, workspaces[0],
+                                      &result.schedule);
+            for (const auto& s : result.schedule) result.makespan = std::max(result.makespan, s.end);
+            result.generations = generation;
+            return result;
+        }
+
+    private:
+        struct Gene
+        {
+            const Operation* op = nullptr;
+            std::vector<int> machines; // eligible machine indices
+            MachineID anchor = -1; // machine it is queued on, -1 when not queued yet
+            int fixture = -1; // packed table numbered from 0 among the genes, -1 when not packed
+        };
+
+        struct Workspace
+        {
+            std::vector<OptMachine> machines;
+            std::vector<int> cursor;
+            std::vector<double> chain_end;
+            std::vector<int> fixture_machine; // machine index of the first placement per packed table, -1 before
+        };
+
+        // runs fn(worker, individual) over a generation, workers live for the whole solve
+        class FitnessPool
+        {
+        public:
+            template <typename Fn>
+            FitnessPool(unsigned threads, Fn&& fn) : fn_(std::forward<Fn>(fn))
+            {
+                for (unsigned w = 1; w < threads; ++w) workers_.emplace_back([this, w]() { loop(w); });
+            }
+
+            ~FitnessPool()
+            {
+                {
+                    std::lock_guard<std::mutex> lk(mutex_);
+                    stop_ = true;
+                }
+                start_.notify_all();
+                for (auto& t : workers_) t.join();
+            }
+
+            void run(int count)
+            {
+                {
+                    std::lock_guard<std::mutex> lk(mutex_);
+                    count_ = count;
+                    next_.store(0);
+                    busy_ = static_cast<int>(workers_.size());
+                    ++round_;
+                }
+                start_.notify_all();
+                work(0);
+                std::unique_lock<std::mutex> lk(mutex_);
+                done_.wait(lk, [&]() { return busy_ == 0; });
+            }
+
+        private:
+            void work(unsigned worker)
+            {
+                for (int i = next_.fetch_add(1); i < count_; i = next_.fetch_add(1)) fn_(worker, i);
+            }
+
+            void loop(unsigned worker)
+            {
+                uint64_t seen = 0;
+                while (true)
+                {
+                    {
+                        std::unique_lock<std::mutex> lk(mutex_);
+                        start_.wait(lk, [&]() { return stop_ || round_ != seen; });
+                        if (stop_) return;
+                        seen = round_;
+                    }
+                    work(worker);
+                    std::lock_guard<std::mutex> lk(mutex_);
+                    if (--busy_ == 0) done_.notify_one();
+                }
+            }
+
+            std::function<void(unsigned, int)> fn_;
+            std::vector<std::thread> workers_;
+            std::mutex mutex_;
+            std::condition_variable start_;
+            std::condition_variable done_;
+            std::atomic<int> next_{0};
+            int count_ = 0;
+            int busy_ = 0;
+            uint64_t round_ = 0;
+            bool stop_ = false;
+        };
+
+        void prepare(Workspace& ws) const
+        {
+            ws.machines = base_;
+            ws.cursor.assign(chains_.size(), 0);
+            ws.chain_end.assign(chains_.size(), 0.0);
+            ws.fixture_machine.assign(fixture_groups_, -1);
+        }
+
+        // objective of the chromosome, the schedule is written out only when asked for
+        // tardiness is counted per part against the earliest due job using it
+        // every queued operation put on another machine adds options_.stability_penalty, except to the late count
+        double decode(const int* genes, Workspace& ws, std::vector<ScheduledOp>* out) const
+        {
+            std::copy(base_.begin(), base_.end(), ws.machines.begin());
+            std::fill(ws.cursor.begin(), ws.cursor.end(), 0);
+            std::copy(chain_release_.begin(), chain_release_.end(), ws.chain_end.begin());
+            std::fill(ws.fixture_machine.begin(), ws.fixture_machine.end(), -1);
+            double makespan = 0.0;
+            int moved = 0;
+            for (size_t k = 0; k < base_genes_.size(); ++k)
+            {
+                const int c = genes[k];
+                const Gene& gene = chains_[c][ws.cursor[c]++];
+                // members of a packed table stay on the machine that got the first one, as in schedule_orders
+                int fixture_mi = gene.fixture >= 0 ? ws.fixture_machine[gene.fixture] : -1;
+                if (fixture_mi >= 0 && !ws.machines[fixture_mi].available) fixture_mi = -1;
+                double start = 0.0;
+                double end = 0.0;
+                const int mi = earliest_completion(*gene.op, ws.chain_end[c], gene.machines, ws.machines, fixture_mi,
+                                                   options_, start, end, gene.anchor);
+                if (mi < 0) continue;
+                if (gene.fixture >= 0) ws.fixture_machine[gene.fixture] = mi;
+                moved += gene.anchor >= 0 && ws.machines[mi].machine_id != gene.anchor;
+                commit_placement(ws.machines[mi], *gene.op, end);
+                ws.chain_end[c] = end;
+                makespan = std::max(makespan, end);
+                if (out) out->push_back(ScheduledOp{gene.op->id, ws.machines[mi].machine_id, start, end});
+            }
+            const double churn = options_.stability_penalty * moved;
+            if (options_.objective == ScheduleObjective::makespan) return makespan + churn;
+            double tardiness = 0.0;
+            int late = 0;
+            for (size_t c = 0; c < chains_.size(); ++c)
+            {
+                const double over = ws.chain_end[c] - chain_due_[c].due;
+                if (over <= 0.0) continue;
+                ++late;
+                tardiness += chain_due_[c].weight * over;
+            }
+            if (options_.objective == ScheduleObjective::on_time) return late + tardiness / (1.0 + tardiness);
+            return tardiness + churn;
+        }
+
+        // chromosome following the order schedule_orders plans in
+        void seed_from_list_order(int* genes)
+        {
+            Graph g;
+            std::vector<OperationID> ops;
+            std::unordered_map<OperationID, int> chain_of_op;
+            for (int c = 0; c < static_cast<int>(chains_.size()); ++c)
+            {
+                for (const auto& gene : chains_[c])
+                {
+                    ops.push_back(gene.op->id);
+                    chain_of_op[gene.op->id] = c;
+                }
+            }
+            for (OperationID opid : ops) g.insert_node(opid);
+            for (const auto& chain : chains_)
+            {
+                for (size_t k = 1; k < chain.size(); ++k)
+                {
+                    g.insert_arc(g.opid_to_index[chain[k - 1].op->id], g.opid_to_index[chain[k].op->id]);
+                }
+            }
+            auto machines = base_;
+            const auto list = schedule_orders(g, machines, state_, 0.0, {}, options_);
+            size_t k = 0;
+            std::vector<int> used(chains_.size(), 0);
+            for (const auto& s : list)
+            {
+                const int c = chain_of_op[s.op_id];
+                genes[k++] = c;
+                ++used[c];
+            }
+            for (int c = 0; c < static_cast<int>(chains_.size()); ++c)
+            {
+                for (size_t r = used[c]; r < chains_[c].size(); ++r) genes[k++] = c;
+            }
+        }
+
+        // precedence preserving order crossover: parts picked at random keep their positions from a,
+        // the other slots take the remaining genes in the order they have in b
+        void crossover(const int* a, const int* b, int* child, std::vector<char>& chosen, std::mt19937_64& rng) const
+        {
+            std::bernoulli_distribution coin(0.5);
+            for (auto& flag : chosen) flag = coin(rng);
+            const int length = static_cast<int>(base_genes_.size());
+            int from_b = 0;
+            for (int k = 0; k < length; ++k)
+            {
+                if (chosen[a[k]])
+                {
+                    child[k] = a[k];
+                    continue;
+                }
+                while (chosen[b[from_b]]) ++from_b;
+                child[k] = b[from_b++];
+            }
+        }
+
+        const ProductionState& state_;
+        ScheduleOptions options_;
+        GeneticOptions genetic_;
+        std::vector<OptMachine> base_;
+        std::vector<std::vector<Gene>> chains_;
+        std::vector<double> chain_release_;
+        std::vector<DueDate> chain_due_;
+        std::vector<int> base_genes_;
+        int fixture_groups_ = 0;
+    };
+
+    inline GeneticResult solve_genetic(Graph& g, const std::vector<OptMachine>& machines,
+                                       const ProductionState& state, double start_time = 0.0,
+                                       const std::unordered_map<int, double>& completed_node_end = {},
+                                       const ScheduleOptions& options = {}, const GeneticOptions& genetic = {})
+    {
+        GeneticScheduler scheduler(g, machines, state, start_time, completed_node_end, options, genetic);
+        return scheduler.solve();
+    }
+}
@@ -0,0 +1,193 @@
+//
+// Schedule quality indicators updated from the engine events
+//
+#pragma once
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
+#include "types.hpp"
+
+// every event is O(1), only the per machine utilization is walked when a snapshot is taken
+class KpiEngine
+{
+public:
+    // seconds of simulated production
+    void advance(double seconds)
+    {
+        now_ += seconds;
+    }
+
+    double now() const
+    {
+        return now_;
+    }
+
+    // starts and stops are counted again so policies can be compared from a common point
+    void reset()
+    {
+        kpis_ = KpiSnapshot{};
+        kpis_.openJobs = static_cast<int>(jobs_.size());
+        kpis_.openParts = openParts_;
+        flowTotal_ = 0.0;
+        start_ = now_;
+        for (auto& [mid, m] : machines_)
+        {
+            m.busy = 0.0;
+            m.down = 0.0;
+            m.added = now_;
+            if (m.since >= 0.0) m.since = now_;
+            if (m.downSince >= 0.0) m.downSince = now_;
+        }
+        kpis_.runningOperations = running_;
+    }
+
+    void machineAdded(MachineID mid)
+    {
+        machines_.emplace(mid, MachineKpi{now_});
+    }
+
+    void jobReleased(int jobId, Priority priority, double due = std::numeric_limits<double>::infinity())
+    {
+        if (!jobs_.emplace(jobId, OpenJob{now_, due, priority}).second) return;
+        ++kpis_.openJobs;
+    }
+
+    void jobCompleted(int jobId)
+    {
+        auto it = jobs_.find(jobId);
+        if (it == jobs_.end()) return;
+        const OpenJob job = it->second;
+        jobs_.erase(it);
+        --kpis_.openJobs;
+        // jobs released before a reset count from the reset
+        const double flow = now_ - std::max(job.released, start_);
+        ++kpis_.completedJobs;
+        flowTotal_ += flow;
+        auto& p = kpis_.byPriority[priorityLevel(job.priority)];
+        ++p.completed;
+        p.totalFlowTime += flow;
+        if (job.due < std::numeric_limits<double>::infinity())
+        {
+            const double lateness = now_ - job.due;
+            if (p.withDueDate == 0 || lateness > p.maxLateness) p.maxLateness = lateness;
+            ++p.withDueDate;
+            p.totalLateness += lateness;
+            if (lateness > 0.0) ++p.late;
+        }
+    }
+
+    void jobDueChanged(int jobId, double due)
+    {
+        auto it = jobs_.find(jobId);
+        if (it != jobs_.end()) it->second.due = due;
+    }
+
+    void partReleased()
+    {
+        ++openParts_;
+    }
+
+    void partCompleted()
+    {
+        --openParts_;
+    }
+
+    void operationStarted(MachineID mid)
+    {
+        auto& m = machine(mid);
+        if (m.since >= 0.0) return;
+        m.since = now_;
+        ++running_;
+    }
+
+    // finished or taken off a failed machine
+    void operationStopped(MachineID mid)
+    {
+        auto& m = machine(mid);
+        if (m.since < 0.0) return;
+        m.busy += now_ - m.since;
+        m.since = -1.0;
+        --running_;
+    }
+
+    void machineFailed(MachineID mid)
+    {
+        auto& m = machine(mid);
+        if (m.downSince < 0.0) m.downSince = now_;
+    }
+
+    void machineRepaired(MachineID mid)
+    {
+        auto& m = machine(mid);
+        if (m.downSince < 0.0) return;
+        m.down += now_ - m.downSince;
+        m.downSince = -1.0;
+    }
+
+    void operationCompleted()
+    {
+        ++kpis_.completedOperations;
+        kpis_.makespan = now_ - start_;
+    }
+
+    // queued work is owned by the engine, it passes the count and the largest machine load
+    KpiSnapshot snapshot(int queuedOperations, double largestQueue) const
+    {
+        KpiSnapshot out = kpis_;
+        out.time = now_ - start_;
+        out.openParts = openParts_;
+        out.runningOperations = running_;
+        out.queuedOperations = queuedOperations;
+        out.projectedMakespan = out.time + largestQueue;
+        out.averageFlowTime = kpis_.completedJobs > 0 ? flowTotal_ / kpis_.completedJobs : 0.0;
+        double total = 0.0;
+        double totalAvailable = 0.0;
+        for (const auto& [mid, m] : machines_)
+        {
+            const double elapsed = now_ - m.added;
+            const double busy = m.busy + (m.since >= 0.0 ? now_ - m.since : 0.0);
+            const double down = m.down + (m.downSince >= 0.0 ? now_ - m.downSince : 0.0);
+            const double u = elapsed > 0.0 ? busy / elapsed : 0.0;
+            const double a = elapsed > 0.0 ? 1.0 - down / elapsed : 1.0;
+            out.utilization[mid] = u;
+            out.availability[mid] = a;
+            total += u;
+            totalAvailable += a;
+        }
+        out.averageUtilization = machines_.empty() ? 0.0 : total / machines_.size();
+        out.averageAvailability = machines_.empty() ? 1.0 : totalAvailable / machines_.size();
+        return out;
+    }
+
+private:
+    struct MachineKpi
+    {
+        double added = 0.0;
+        double busy = 0.0;
+        double since = -1.0; // start of the running operation, -1 when idle
+        double down = 0.0;
+        double downSince = -1.0; // start of the failure, -1 when working
+    };
+
+    struct OpenJob
+    {
+        double released;
+        double due;
+        Priority priority;
+    };
+
+    MachineKpi& machine(MachineID mid)
+    {
+        return machines_.try_emplace(mid, MachineKpi{start_}).first->second;
+    }
+
+    double now_ = 0.0;
+    double start_ = 0.0;
+    KpiSnapshot kpis_;
+    double flowTotal_ = 0.0;
+    int openParts_ = 0;
+    int running_ = 0;
+    std::unordered_map<MachineID, MachineKpi> machines_;
+    std::unordered_map<int, OpenJob> jobs_;
+};
@@ -0,0 +1,294 @@
+//
+// Monte Carlo evaluation of a plan under random failures and processing time variation
+//
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Reliability.hpp"
+#include "ScheduleEvaluator.hpp"
+
+namespace OptiProSimple
+{
+    struct MonteCarloOptions
+    {
+        int runs = 200;
+        // coefficient of variation of the processing times, lognormal around the planned duration
+        double duration_cv = 0.1;
+        bool failures = true;
+        uint64_t seed = 1;
+        // 0 uses every core
+        unsigned threads = 0;
+    };
+
+    // mean, spread and percentiles of the samples, sorts them
+    inline Distribution summarize(std::vector<double>& samples)
+    {
+        Distribution d;
+        if (samples.empty()) return d;
+        std::sort(samples.begin(), samples.end());
+        const size_t n = samples.size();
+        auto quantile = [&](double q) { return samples[std::min(n - 1, static_cast<size_t>(q * (n - 1) + 0.5))]; };
+        double sum = 0.0;
+        for (double v : samples) sum += v;
+        d.mean = sum / n;
+        double var = 0.0;
+        for (double v : samples) var += (v - d.mean) * (v - d.mean);
+        d.stddev = n > 1 ? std::sqrt(var / (n - 1)) : 0.0;
+        d.min = samples.front();
+        d.p50 = quantile(0.5);
+        d.p90 = quantile(0.9);
+        d.p95 = quantile(0.95);
+        d.max = samples.back();
+        return d;
+    }
+
+    // lognormal factor on a planned duration with mean 1 and the options spread
+    inline std::lognormal_distribution<double> duration_noise(const MonteCarloOptions& options)
+    {
+        const double sigma = std::sqrt(std::log(1.0 + options.duration_cv * options.duration_cv));
+        return std::lognormal_distribution<double>(-0.5 * sigma * sigma, sigma);
+    }
+
+    // each run has its own stream so the results do not depend on the thread count
+    inline std::mt19937_64 replication_rng(const MonteCarloOptions& options, int run)
+    {
+        std::seed_seq seq{static_cast<uint32_t>(options.seed), static_cast<uint32_t>(options.seed >> 32),
+                          static_cast<uint32_t>(run)};
+        return std::mt19937_64(seq);
+    }
+
+    // planned stops per machine as [start, end) seconds from the plan start, sorted by start
+    using OutageWindows = std::unordered_map<MachineID, std::vector<std::pair<double, double>>>;
+
+    // one disturbed execution of the plan: the machine orders are kept, durations are drawn around the planned
+    // ones and a failure or a planned outage pauses the machine, the operation resumes where it stopped
+    // the engine reassigns the work of a stopped machine instead, so this is the plan held as is
+    // outages holds the windows of each machine index
+    template <class Rng>
+    inline EvalResult simulate_replication(const EvalProblem& problem, const MachineSequence& sequence,
+                                           const std::vector<int>& machine_of,
+                                           const std::vector<const ReliabilityProfile*>& machine_profiles,
+                                           const std::vector<std::vector<std::pair<double, double>>>& outages,
+                                           const MonteCarloOptions& options, EvalWorkspace& ws,
+                                           std::vector<double>& next_failure, std::vector<size_t>& next_outage,
+                                           Rng& rng)
+    {
+        const int n = problem.operations;
+        auto noise = duration_noise(options);
+        for (int m = 0; m < problem.machines; ++m)
+        {
+            next_failure[m] = options.failures ? machine_profiles[m]->failure.sample(rng)
+                                               : std::numeric_limits<double>::infinity();
+            next_outage[m] = 0;
+        }
+        std::fill(ws.machine_pred.begin(), ws.machine_pred.end(), -1);
+        std::fill(ws.machine_succ.begin(), ws.machine_succ.end(), -1);
+        std::fill(ws.job_succ_head.begin(), ws.job_succ_head.end(), -1);
+        for (int m = 0; m < problem.machines; ++m)
+        {
+            for (int k = sequence.offsets[m] + 1; k < sequence.offsets[m + 1]; ++k)
+            {
+                ws.machine_pred[sequence.ops[k]] = sequence.ops[k - 1];
+                ws.machine_succ[sequence.ops[k - 1]] = sequence.ops[k];
+            }
+        }
+        int head = 0;
+        int tail = 0;
+        for (int o = 0; o < n; ++o)
+        {
+            const int jp = problem.job_pred[o];
+            if (jp >= 0) ws.job_succ_head[jp] = o;
+            ws.indegree[o] = (jp >= 0) + (ws.machine_pred[o] >= 0);
+            if (ws.indegree[o] == 0) ws.ready[tail++] = o;
+        }
+
+        EvalResult result;
+        while (head < tail)
+        {
+            const int o = ws.ready[head++];
+            const int m = machine_of[o];
+            const auto& repair = machine_profiles[m]->repair;
+            double s = problem.release[o];
+            if (problem.job_pred[o] >= 0) s = std::max(s, ws.end[problem.job_pred[o]]);
+            if (ws.machine_pred[o] >= 0) s = std::max(s, ws.end[ws.machine_pred[o]]);
+            double& fail = next_failure[m];
+            const auto& windows = outages[m];
+            size_t& w = next_outage[m];
+            // stops while the machine waited, only one still going delays the start
+            auto wait = [&]()
+            {
+                while (true)
+                {
+                    while (w < windows.size() && windows[w].second <= s) ++w;
+                    if (fail <= s)
+                    {
+                        const double up = fail + repair.sample(rng);
+                        s = std::max(s, up);
+                        fail = up + machine_profiles[m]->failure.sample(rng);
+                    }
+                    else if (w < windows.size() && windows[w].first <= s) s = windows[w].second;
+                    else break;
+                }
+            };
+            wait();
+            double remaining = problem.duration[o] * (options.duration_cv > 0.0 ? noise(rng) : 1.0);
+            while (true)
+            {
+                const double outage = w < windows.size() ? windows[w].first : std::numeric_limits<double>::infinity();
+                const double stop = std::min(fail, outage);
+                if (s + remaining <= stop) break;
+                remaining -= stop - s;
+                s = stop;
+                wait();
+            }
+            ws.start[o] = s;
+            ws.end[o] = s + remaining;
+            result.makespan = std::max(result.makespan, ws.end[o]);
+            const double over = ws.end[o] - problem.due[o];
+            if (over > 0.0)
+            {
+                result.total_tardiness += problem.weight[o] * over;
+                ++result.late;
+            }
+            for (int next : {ws.job_succ_head[o], ws.machine_succ[o]})
+            {
+                if (next >= 0 && --ws.indegree[next] == 0) ws.ready[tail++] = next;
+            }
+        }
+        result.feasible = tail == n;
+        return result;
+    }
+
+    // runs the plan options.runs times with independent seeds across the cores and reports the spread of the
+    // makespan, weighted tardiness and late parts; schedule times count from state.time like a fresh plan
+    // outages are stops known in advance, they apply to every run
+    inline RobustnessReport monte_carlo_schedule(const ProductionState& state,
+                                                 const std::vector<ScheduledOp>& schedule,
+                                                 const ReliabilityModel& reliability,
+                                                 const MonteCarloOptions& options = {},
+                                                 const OutageWindows& outages = {})
+    {
+        RobustnessReport report;
+        report.planTime = state.time;
+        EvalProblem problem;
+        MachineSequence sequence;
+        encode_schedule(state, schedule, problem, sequence);
+        {
+            EvalWorkspace ws;
+            ws.reserve(problem);
+            const auto planned = evaluate_sequence(problem, sequence, ws);
+            report.plannedMakespan = planned.makespan;
+            report.plannedTardiness = planned.total_tardiness;
+        }
+        const int runs = std::max(0, options.runs);
+        if (runs == 0 || problem.operations == 0) return report;
+
+        const ReliabilityProfile never{};
+        std::vector<const ReliabilityProfile*> profiles(problem.machines, &never);
+        std::vector<int> machine_of(problem.operations, 0);
+        std::vector<std::vector<std::pair<double, double>>> windows(problem.machines);
+        for (int m = 0; m < problem.machines; ++m)
+        {
+            auto it = state.machines.find(problem.machine_ids[m]);
+            // a failure time of 0 would never let the machine work
+            if (it != state.machines.end() && reliability.profile(it->second).failure.mean > 0.0)
+                profiles[m] = &reliability.profile(it->second);
+            for (int k = sequence.offsets[m]; k < sequence.offsets[m + 1]; ++k) machine_of[sequence.ops[k]] = m;
+            auto itout = outages.find(problem.machine_ids[m]);
+            if (itout == outages.end()) continue;
+            windows[m] = itout->second;
+            std::sort(windows[m].begin(), windows[m].end());
+        }
+
+        std::vector<double> makespan(runs), tardiness(runs), late(runs);
+        std::vector<char> feasible(runs, 0);
+        auto record = [&](int r, const EvalResult& result)
+        {
+            feasible[r] = result.feasible;
+            makespan[r] = result.makespan;
+            tardiness[r] = result.total_tardiness;
+            late[r] = result.late;
+        };
+        std::atomic<int> next{0};
+        auto replicate = [&]()
+        {
+            EvalWorkspace ws;
+            ws.reserve(problem);
+            std::vector<double> next_failure(problem.machines);
+            std::vector<size_t> next_outage(problem.machines);
+            for (int r = next++; r < runs; r = next++)
+            {
+                auto rng = replication_rng(options, r);
+                record(r, simulate_replication(problem, sequence, machine_of, profiles, windows, options, ws,
+                                               next_failure, next_outage, rng));
+            }
+        };
+        // without stops a run only draws its durations and the machine orders are the planned ones in every run,
+        // so blocks of runs go through the batched evaluator side by side
+        constexpr int lanes = 8;
+        auto replicate_batch = [&]()
+        {
+            EvalBatch<lanes> batch;
+            batch.reserve(problem);
+            for (int l = 0; l < lanes; ++l) batch.load(l, problem, sequence);
+            auto noise = duration_noise(options);
+            for (int first = next.fetch_add(lanes); first < runs; first = next.fetch_add(lanes))
+            {
+                const int used = std::min(lanes, runs - first);
+                for (int l = 0; l < used; ++l)
+                {
+                    auto rng = replication_rng(options, first + l);
+                    noise.reset();
+                    for (int o = 0; o < problem.operations; ++o)
+                    {
+                        batch.duration[static_cast<size_t>(o) * lanes + l] =
+                            problem.duration[o] * (options.duration_cv > 0.0 ? noise(rng) : 1.0);
+                    }
+                }
+                evaluate_batch(problem, batch);
+                for (int l = 0; l < used; ++l) record(first + l, batch.results[l]);
+            }
+        };
+        auto on_every_core = [&](auto& work, int jobs)
+        {
+            unsigned threads = options.threads ? options.threads : std::thread::hardware_concurrency();
+            threads = std::clamp(threads, 1u, static_cast<unsigned>(jobs));
+            std::vector<std::thread> workers;
+            for (unsigned t = 1; t < threads; ++t) workers.emplace_back(work);
+            work();
+            for (auto& w : workers) w.join();
+        };
+        const bool stops = options.failures ||
+            std::any_of(windows.begin(), windows.end(), [](const auto& w) { return !w.empty(); });
+        if (stops) on_every_core(replicate, runs);
+        else on_every_core(replicate_batch, (runs + lanes - 1) / lanes);
+
+        // a cycle leaves operations without times, those runs say nothing about the spread
+        int kept = 0;
+        for (int r = 0; r < runs; ++r)
+        {
+            if (!feasible[r]) continue;
+            makespan[kept] = makespan[r];
+            tardiness[kept] = tardiness[r];
+            late[kept] = late[r];
+            ++kept;
+        }
+        makespan.resize(kept);
+        tardiness.resize(kept);
+        late.resize(kept);
+
+        report.runs = runs;
+        report.infeasibleRuns = runs - kept;
+        report.makespan = summarize(makespan);
+        report.tardiness = summarize(tardiness);
+        report.late = summarize(late);
+        return report;
+    }
+}
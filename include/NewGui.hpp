@@ -1,14 +1,18 @@
 #pragma once
+#include <algorithm>
 #include <imgui_internal.h>
 
 #include "imgui.h"
 #include "Engine.hpp"
+#include "ShardedEngine.hpp"
 
 
 class GuiManager
 {
 private:
-    Engine& engine_;
+    // the engine the cell windows send to, in plant mode the selected cell
+    mutable Engine* engine_;
+    ShardedEngine* plant_ = nullptr;
     ImGuiWindowFlags window_flags = ImGuiWindowFlags_NoTitleBar |
         ImGuiWindowFlags_NoCollapse |
         ImGuiWindowFlags_NoResize |
@@ -16,11 +20,51 @@ private:
         ImGuiWindowFlags_NoMove;
 
 public:
-    explicit GuiManager(Engine& engine) : engine_(engine)
+    explicit GuiManager(Engine& engine) : engine_(&engine)
+    {
+    }
+
+    // plant mode, one engine per cell behind the router
+    explicit GuiManager(ShardedEngine& plant) : engine_(&plant.cell(0)), plant_(&plant)
     {
     }
 
     void renderGui(const StateSnapshot& snapshot) const
+    {
+        Dockspace();
+
+        //Render the 4 Panels as standard Windows
+        RenderJobsWindow(snapshot);
+        RenderMachinesWindow(snapshot);
+        RenderOperationsWindow(snapshot);
+        RenderPartsWindow(snapshot);
+        RenderKpiWindow(snapshot);
+        RenderControlGui(snapshot);
+    }
+
+    // the cell windows show the selected cell and send to its engine, the plant window shows the aggregated
+    // snapshot and its controls go through the router
+    void renderPlantGui(const ShardedSnapshot& plant) const
+    {
+        static int selected_cell = 0;
+        static const StateSnapshot no_snapshot{};
+        Dockspace();
+
+        selected_cell = std::clamp(selected_cell, 0, static_cast<int>(plant_->cellCount()) - 1);
+        engine_ = &plant_->cell(selected_cell);
+        const bool seen = selected_cell < static_cast<int>(plant.cells.size()) && plant.cells[selected_cell];
+        const StateSnapshot& cell = seen ? *plant.cells[selected_cell] : no_snapshot;
+
+        RenderJobsWindow(cell);
+        RenderMachinesWindow(cell);
+        RenderOperationsWindow(cell);
+        RenderPartsWindow(cell);
+        RenderKpiWindow(cell);
+        RenderPlantWindow(plant, selected_cell);
+        RenderPlantControlGui(plant, cell);
+    }
+
+    void Dockspace() const
     {
         // make the dockspace cover the entire viewport automatically
         ImGuiID dockspace_id = ImGui::GetID("MyDashboardDockSpace");
@@ -33,20 +77,13 @@ public:
             ApplyDefaultLayout(dockspace_id);
             first_time = false;
         }
-
-        //Render the 4 Panels as standard Windows
-        RenderJobsWindow(snapshot);
-        RenderMachinesWindow(snapshot);
-        RenderOperationsWindow(snapshot);
-        RenderPartsWindow(snapshot);
-        RenderControlGui(snapshot);
     }
 
     void RenderJobsWindow(const StateSnapshot& snapshot) const
     {
         ImGui::Begin("Jobs_window", nullptr, window_flags);
         {
-            if (ImGui::BeginTable("TableJobs", 7,
+            if (ImGui::BeginTable("TableJobs", 8,
                                   ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable))
             {
                 ImGui::TableSetupColumn("Job ID / Parts");
@@ -54,7 +91,8 @@ public:
                 ImGui::TableSetupColumn("Total Parts");
                 ImGui::TableSetupColumn("Created");
                 ImGui::TableSetupColumn("Started");
-                ImGui::TableSetupColumn("Finished");
+                ImGui::TableSetupColumn("Finished (s)");
+                ImGui::TableSetupColumn("Due (s)");
                 ImGui::TableSetupColumn("Status");
                 ImGui::TableHeadersRow();
 
@@ -79,9 +117,19 @@ public:
                     ImGui::Text("%s", TimeToString(job.startedTime).c_str());
 
                     ImGui::TableSetColumnIndex(5);
-                    ImGui::Text("%s", TimeToString(job.finishedTime).c_str());
+                    if (job.finishedTime >= 0.0) ImGui::Text("%.0f", job.finishedTime);
+                    else ImGui::TextDisabled("-");
 
                     ImGui::TableSetColumnIndex(6);
+                    if (job.dueTime < std::numeric_limits<double>::infinity())
+                    {
+                        if (job.state != State::completed && job.dueTime < snapshot.productionState.time)
+                            ImGui::TextColored(ImVec4(1, 0, 0, 1), "%.0f", job.dueTime);
+                        else ImGui::Text("%.0f", job.dueTime);
+                    }
+                    else ImGui::TextDisabled("-");
+
+                    ImGui::TableSetColumnIndex(7);
                     if (job.state == State::running)
                     {
                         ImGui::TextColored(ImVec4(0, 1, 0, 1), "%s", toString(job.state).data());
@@ -116,7 +164,7 @@ public:
                                 // Look up part info if needed, here we just show ID and Qty
                                 ImGui::Text("  Part %d (x%u)", partId, qty);
 
-                                ImGui::TableSetColumnIndex(6);
+                                ImGui::TableSetColumnIndex(7);
                                 auto part = snapshot.productionState.parts.at(partId);
                                 if (part.state == State::running)
                                 {
@@ -354,6 +402,139 @@ public:
         }
     }
 
+    void RenderKpiWindow(const StateSnapshot& snapshot) const
+    {
+        const auto& kpis = snapshot.kpis;
+        ImGui::Begin("KPI_window", nullptr, window_flags);
+        {
+            ImGui::Text("Elapsed: %.0f s", kpis.time);
+            ImGui::SameLine();
+            if (ImGui::Button("Reset KPIs"))
+            {
+                engine_->sendCommand(ResetKpisCommand{});
+            }
+            ImGui::Text("Makespan: %.0f s", kpis.makespan);
+            ImGui::SameLine();
+            ImGui::Text("Projected: %.0f s", kpis.projectedMakespan);
+            ImGui::Text("Average utilization: %.1f %%", kpis.averageUtilization * 100.0);
+            ImGui::SameLine();
+            ImGui::Text("Availability: %.1f %%", kpis.averageAvailability * 100.0);
+            ImGui::Text("Average flow time: %.0f s", kpis.averageFlowTime);
+            int due = 0, late = 0;
+            for (const auto& p : kpis.byPriority)
+            {
+                due += p.withDueDate;
+                late += p.late;
+            }
+            if (due > 0) ImGui::Text("On time delivery: %.1f %% (%d of %d)", 100.0 * (due - late) / due, due - late, due);
+            else ImGui::TextDisabled("On time delivery: -");
+
+            ImGui::Separator();
+            ImGui::Text("Work in progress:");
+            ImGui::Text("Jobs: %d  Parts: %d  Running ops: %d  Queued ops: %d", kpis.openJobs, kpis.openParts,
+                        kpis.runningOperations, kpis.queuedOperations);
+            ImGui::Text("Completed jobs: %d  Completed ops: %d", kpis.completedJobs, kpis.completedOperations);
+
+            ImGui::Separator();
+            const auto& stability = snapshot.planStability;
+            ImGui::Text("Plan changes: %d  (moved %lld, resequenced %lld)", stability.replans, stability.moved,
+                        stability.resequenced);
+            if (stability.replans > 0)
+            {
+                const auto& last = stability.last;
+                ImGui::Text("Last: %d kept, %d moved, %d resequenced, %d new", last.kept, last.moved,
+                            last.resequenced, last.added);
+                ImGui::Text("Start shift: mean %.0f s, max %.0f s", last.meanStartShift, last.maxStartShift);
+            }
+
+            ImGui::Separator();
+            RobustnessControls(snapshot);
+
+            ImGui::Separator();
+            if (ImGui::BeginTable("TableKpiPriority", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+            {
+                ImGui::TableSetupColumn("Priority");
+                ImGui::TableSetupColumn("Completed");
+                ImGui::TableSetupColumn("Avg Flow");
+                ImGui::TableSetupColumn("Avg Lateness");
+                ImGui::TableSetupColumn("Late");
+                ImGui::TableHeadersRow();
+
+                for (Priority priority : {Priority::urgent, Priority::high, Priority::normal, Priority::low})
+                {
+                    const auto& p = kpis.byPriority[priorityLevel(priority)];
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::Text("%s", toString(priority).data());
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::Text("%d", p.completed);
+                    ImGui::TableSetColumnIndex(2);
+                    ImGui::Text("%.0f s", p.completed > 0 ? p.totalFlowTime / p.completed : 0.0);
+                    ImGui::TableSetColumnIndex(3);
+                    if (p.withDueDate > 0) ImGui::Text("%.0f s", p.totalLateness / p.withDueDate);
+                    else ImGui::TextDisabled("-");
+                    ImGui::TableSetColumnIndex(4);
+                    if (p.late > 0) ImGui::TextColored(ImVec4(1, 0, 0, 1), "%d", p.late);
+                    else ImGui::Text("%d", p.late);
+                }
+                ImGui::EndTable();
+            }
+
+            ImGui::Separator();
+            if (ImGui::BeginTable("TableKpiMachines", 3,
+                                  ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+            {
+                ImGui::TableSetupColumn("Machine");
+                ImGui::TableSetupColumn("Utilization");
+                ImGui::TableSetupColumn("Availability");
+                ImGui::TableHeadersRow();
+                for (const auto& [mid, u] : kpis.utilization)
+                {
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::Text("Machine %d", mid);
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::ProgressBar(static_cast<float>(u), ImVec2(-1, 0));
+                    ImGui::TableSetColumnIndex(2);
+                    auto ita = kpis.availability.find(mid);
+                    ImGui::Text("%.1f %%", ita != kpis.availability.end() ? ita->second * 100.0 : 100.0);
+                }
+                ImGui::EndTable();
+            }
+        }
+        ImGui::End();
+    }
+
+    void RobustnessControls(const StateSnapshot& snapshot) const
+    {
+        static int monte_carlo_runs = 200;
+        ImGui::SliderInt("##Monte Carlo runs", &monte_carlo_runs, 10, 2000);
+        ImGui::SameLine();
+        if (ImGui::Button("Evaluate Robustness"))
+        {
+            OptiProSimple::MonteCarloOptions options;
+            options.runs = monte_carlo_runs;
+            engine_->sendCommand(RunMonteCarloCommand{options});
+        }
+        if (!snapshot.robustness)
+        {
+            ImGui::TextDisabled("Robustness: not evaluated");
+            return;
+        }
+        const auto& r = *snapshot.robustness;
+        ImGui::Text("Robustness at %.0f s, %d runs", r.planTime, r.runs);
+        if (r.infeasibleRuns > 0)
+        {
+            ImGui::SameLine();
+            ImGui::TextColored(ImVec4(1, 0.5f, 0, 1), "(%d infeasible, left out)", r.infeasibleRuns);
+        }
+        ImGui::Text("Makespan: planned %.0f s, p50 %.0f s, p90 %.0f s, max %.0f s", r.plannedMakespan,
+                    r.makespan.p50, r.makespan.p90, r.makespan.max);
+        ImGui::Text("Tardiness: planned %.0f, p50 %.0f, p90 %.0f", r.plannedTardiness, r.tardiness.p50,
+                    r.tardiness.p90);
+        ImGui::Text("Late parts: mean %.1f, p90 %.0f", r.late.mean, r.late.p90);
+    }
+
     void RenderControlGui(const StateSnapshot& snapshot) const
     {
         ImGui::Begin("Control Panel");
@@ -364,6 +545,186 @@ public:
             ImGui::Separator();
             JobGenButton(snapshot);
             ImGui::Separator();
+            ClockControls(snapshot);
+            ImGui::Separator();
+            WhatIfControls(snapshot);
+        }
+        ImGui::End();
+    }
+
+    void WhatIfControls(const StateSnapshot& snapshot) const
+    {
+        static int outage_machine = 0;
+        static float outage_hours = 4.0f;
+        static int rush_job = 0;
+        static float rush_due_hours = 8.0f;
+
+        ImGui::Text("What if:");
+        ImGui::InputInt("Machine##what if", &outage_machine);
+        ImGui::SliderFloat("Down hours", &outage_hours, 0.5f, 48.0f, "%.1f h");
+        if (ImGui::Button("Machine Down"))
+        {
+            WhatIfScenario scenario;
+            scenario.name = "machine " + std::to_string(outage_machine) + " down";
+            scenario.outages.push_back(MachineOutage{outage_machine, 0.0, outage_hours * 3600.0});
+            engine_->sendCommand(RunWhatIfCommand{{scenario}, {}});
+        }
+        ImGui::InputInt("Repeat job##what if", &rush_job);
+        ImGui::SliderFloat("Due in", &rush_due_hours, 1.0f, 72.0f, "%.1f h");
+        if (ImGui::Button("Rush Order"))
+        {
+            WhatIfScenario scenario;
+            scenario.name = "rush repeat of job " + std::to_string(rush_job);
+            scenario.orders.push_back(RushOrder{rush_job, Priority::urgent, rush_due_hours * 3600.0});
+            engine_->sendCommand(RunWhatIfCommand{{scenario}, {}});
+        }
+
+        if (snapshot.whatIf.empty()) return;
+        if (ImGui::BeginTable("TableWhatIf", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+        {
+            ImGui::TableSetupColumn("Scenario");
+            ImGui::TableSetupColumn("Makespan p50");
+            ImGui::TableSetupColumn("Tardiness p50");
+            ImGui::TableSetupColumn("Late parts");
+            ImGui::TableHeadersRow();
+            for (const auto& r : snapshot.whatIf)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%s", r.name.c_str());
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%.0f -> %.0f s", r.baseline.makespan.p50, r.scenario.makespan.p50);
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%.0f -> %.0f", r.baseline.tardiness.p50, r.scenario.tardiness.p50);
+                ImGui::TableSetColumnIndex(3);
+                ImGui::Text("%.1f -> %.1f", r.baseline.late.mean, r.scenario.late.mean);
+            }
+            ImGui::EndTable();
+        }
+    }
+
+    void ClockControls(const StateSnapshot& snapshot) const
+    {
+        static float time_scale = 1.0f;
+        static int fast_forward_minutes = 60;
+
+        ImGui::Text("Simulated time: %.0f s", snapshot.productionState.time);
+        if (ImGui::SliderFloat("Time Scale", &time_scale, 0.0f, 100.0f, "x%.1f"))
+        {
+            sendClock(SetTimeScaleCommand{time_scale});
+        }
+        ImGui::SliderInt("##Fast forward minutes", &fast_forward_minutes, 1, 480);
+        ImGui::SameLine();
+        if (ImGui::Button("Fast Forward"))
+        {
+            sendClock(FastForwardCommand{fast_forward_minutes * 60.0});
+        }
+    }
+
+    // every cell runs on the same clock in plant mode
+    void sendClock(const CommandVariant& command) const
+    {
+        if (plant_) plant_->broadcast(command);
+        else engine_->sendCommand(command);
+    }
+
+    void RenderPlantWindow(const ShardedSnapshot& plant, int& selected_cell) const
+    {
+        const auto& kpis = plant.kpis;
+        ImGui::Begin("Plant_window", nullptr, window_flags);
+        {
+            ImGui::Text("Cells: %zu  Pooled orders: %d", plant.cells.size(), plant.pooledOrders);
+            ImGui::SameLine();
+            if (plant.unroutableOrders > 0)
+                ImGui::TextColored(ImVec4(1, 0.5f, 0, 1), "Unroutable: %d", plant.unroutableOrders);
+            else ImGui::Text("Unroutable: 0");
+            ImGui::Text("Makespan: %.0f s", kpis.makespan);
+            ImGui::SameLine();
+            ImGui::Text("Projected: %.0f s", kpis.projectedMakespan);
+            ImGui::Text("Average utilization: %.1f %%", kpis.averageUtilization * 100.0);
+            ImGui::SameLine();
+            ImGui::Text("Availability: %.1f %%", kpis.averageAvailability * 100.0);
+            ImGui::Text("Average flow time: %.0f s", kpis.averageFlowTime);
+            ImGui::Text("Jobs: %d  Parts: %d  Running ops: %d  Queued ops: %d", kpis.openJobs, kpis.openParts,
+                        kpis.runningOperations, kpis.queuedOperations);
+            ImGui::Text("Completed jobs: %d  Completed ops: %d", kpis.completedJobs, kpis.completedOperations);
+
+            ImGui::Separator();
+            ImGui::Text("Cells, select one to show it in the other windows:");
+            if (ImGui::BeginTable("TablePlantCells", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+            {
+                ImGui::TableSetupColumn("Cell");
+                ImGui::TableSetupColumn("Routed");
+                ImGui::TableSetupColumn("Backlog");
+                ImGui::TableSetupColumn("Open jobs");
+                ImGui::TableSetupColumn("Completed jobs");
+                ImGui::TableSetupColumn("Utilization");
+                ImGui::TableHeadersRow();
+                for (size_t c = 0; c < plant.cells.size(); ++c)
+                {
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    const std::string label = "Cell " + std::to_string(c);
+                    if (ImGui::Selectable(label.c_str(), selected_cell == static_cast<int>(c),
+                                          ImGuiSelectableFlags_SpanAllColumns))
+                    {
+                        selected_cell = static_cast<int>(c);
+                    }
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::Text("%d", c < plant.routed.size() ? plant.routed[c] : 0);
+                    ImGui::TableSetColumnIndex(2);
+                    ImGui::Text("%.0f s", c < plant.backlog.size() ? plant.backlog[c] : 0.0);
+                    const auto& cell = plant.cells[c];
+                    if (!cell)
+                    {
+                        ImGui::TableSetColumnIndex(3);
+                        ImGui::TextDisabled("starting");
+                        continue;
+                    }
+                    ImGui::TableSetColumnIndex(3);
+                    ImGui::Text("%d", cell->kpis.openJobs);
+                    ImGui::TableSetColumnIndex(4);
+                    ImGui::Text("%d", cell->kpis.completedJobs);
+                    ImGui::TableSetColumnIndex(5);
+                    ImGui::ProgressBar(static_cast<float>(cell->kpis.averageUtilization), ImVec2(-1, 0));
+                }
+                ImGui::EndTable();
+            }
+        }
+        ImGui::End();
+    }
+
+    void RenderPlantControlGui(const ShardedSnapshot& plant, const StateSnapshot& cell) const
+    {
+        static int plant_tools = 40;
+        static int machines_per_cell = 10;
+        static int plant_jobs = 50;
+
+        ImGui::Begin("Control Panel");
+        {
+            ImGui::Text("Plant:");
+            ImGui::SliderInt("Tools##plant", &plant_tools, 1, 128);
+            ImGui::SliderInt("Machines per cell", &machines_per_cell, 1, 64);
+            if (ImGui::Button("Generate Plant"))
+            {
+                plant_->generateShop(plant_tools, machines_per_cell);
+            }
+            bool create_jobs_disabled = std::none_of(plant.cells.begin(), plant.cells.end(), [](const auto& c)
+            {
+                return c && !c->productionState.machines.empty();
+            });
+            if (create_jobs_disabled) ImGui::BeginDisabled();
+            ImGui::SliderInt("##Plant jobs", &plant_jobs, 1, 1000);
+            ImGui::SameLine();
+            if (ImGui::Button("Route Jobs"))
+            {
+                plant_->generateRandomJobs(plant_jobs);
+            }
+            if (create_jobs_disabled) ImGui::EndDisabled();
+            ImGui::Separator();
+            ClockControls(cell);
+            ImGui::Separator();
+            WhatIfControls(cell);
         }
         ImGui::End();
     }
@@ -404,6 +765,8 @@ public:
         ImGui::DockBuilderDockWindow("Jobs_window", dock_id_top_left);
         ImGui::DockBuilderDockWindow("Machines_window", dock_id_bottom_left);
         ImGui::DockBuilderDockWindow("Operations_window", dock_id_top_right);
+        ImGui::DockBuilderDockWindow("KPI_window", dock_id_top_right);
+        ImGui::DockBuilderDockWindow("Plant_window", dock_id_top_right);
         ImGui::DockBuilderDockWindow("Parts_window", dock_id_bottom_right_top);
         ImGui::DockBuilderDockWindow("Control Panel", dock_id_bottom_right_bottom);
 
@@ -426,7 +789,7 @@ public:
         if (create_machines_disabled) ImGui::BeginDisabled();
         if (ImGui::Button("Generate Machines"))
         {
-            engine_.sendCommand(GenerateRandomMachinesCommand{machine_gen_amount});
+            engine_->sendCommand(GenerateRandomMachinesCommand{machine_gen_amount});
             std::cout << "Generated random machines" << std::endl;
         }
         if (create_machines_disabled) ImGui::EndDisabled();
@@ -443,7 +806,7 @@ public:
 
         if (ImGui::Button("Generate Tools"))
         {
-            engine_.sendCommand(GenerateRandomToolsCommand{tool_gen_amount});
+            engine_->sendCommand(GenerateRandomToolsCommand{tool_gen_amount});
         }
     }
 
@@ -477,7 +840,17 @@ public:
 
         if (ImGui::Button("Generate Jobs"))
         {
-            engine_.sendCommand(GenerateRandomJobsCommand{job_gen_amount_min, job_gen_amount_max});
+            engine_->sendCommand(GenerateRandomJobsCommand{job_gen_amount_min, job_gen_amount_max});
+        }
+
+        //bulk generation for load tests
+        static int bulk_job_amount = 10000;
+        ImGui::SetNextItemWidth(width);
+        ImGui::SliderInt("##Bulk Job amount", &bulk_job_amount, 1000, 200000);
+        ImGui::SameLine();
+        if (ImGui::Button("Generate Bulk Jobs"))
+        {
+            engine_->sendCommand(GenerateBulkJobsCommand{bulk_job_amount});
         }
         if (create_jobs_disabled) ImGui::EndDisabled();
     }
@@ -5,13 +5,18 @@
 
 #pragma once
 #include <vector>
+#include <deque>
 #include <queue>
 #include <unordered_map>
 #include <unordered_set>
 #include <algorithm>
+#include <array>
+#include <cmath>
 #include <functional>
+#include <limits>
 #include <memory>
 #include "types.hpp"
+#include "Tooling.hpp"
 
 
 namespace OptiProSimple
@@ -25,8 +30,132 @@ namespace OptiProSimple
         MachineID machine_id = -1;
         bool available = true;
         double available_time = 0.0;
+        ToolMagazine magazine; // tools loaded on the machine, updated as operations are planned
+        int last_family = -1; // setup family of the last planned operation
+        int last_fixture = -1; // fixture group of the last planned operation
     };
 
+    enum class ScheduleObjective
+    {
+        makespan, // finish the whole backlog as early as possible
+        weighted_tardiness, // sum of priority weight * time late over the jobs with a due date
+        on_time // number of jobs late, weighted tardiness breaks ties
+    };
+
+    struct ScheduleOptions
+    {
+        // what the ready queue and the search backends minimise
+        ScheduleObjective objective = ScheduleObjective::makespan;
+        // charge setup depending on the tools already loaded on the machine instead of always
+        bool sequence_dependent_setup = true;
+        // after planning an operation, prefer ready operations with the same setup next
+        bool batch_setups = false;
+        // fraction of setupTime still paid when every tool is loaded (fixturing, first piece check)
+        double residual_setup_fraction = 0.1;
+        // seconds to swap one tool into the magazine
+        double tool_change_time = 6.0;
+        // pack small compatible parts onto one table when dispatching new jobs
+        bool pack_fixtures = false;
+        // new jobs are only inserted into the running plan, a full replan runs on a worker thread
+        bool background_reoptimize = true;
+        // seconds a replan is charged for putting a queued operation on another machine, 0 moves freely
+        double stability_penalty = 0.0;
+    };
+
+    // machine type, specs and magazine size allow the machine to run op
+    inline bool machine_can_run(const Machine& m, const Operation& op)
+    {
+        if (m.machineType != op.requiredMachine) return false;
+        for (const auto& spec : op.requiredMachineSpces)
+        {
+            if (m.machineSpecs.find(spec) == m.machineSpecs.end()) return false;
+        }
+        return m.magazineCapacity == 0 || op.tools.size() <= m.magazineCapacity;
+    }
+
+    // part fits the work envelope, it may be turned 90 degrees on the table but not tipped over
+    inline bool part_fits_envelope(const SizeXYZ& part, const SizeXYZ& envelope)
+    {
+        if (part.Z > envelope.Z) return false;
+        return (part.X <= envelope.X && part.Y <= envelope.Y) || (part.X <= envelope.Y && part.Y <= envelope.X);
+    }
+
+    inline bool machine_can_run(const Machine& m, const Operation& op, const SizeXYZ& part_size)
+    {
+        return machine_can_run(m, op) && part_fits_envelope(part_size, m.workEnvelope);
+    }
+
+    // machines per type sorted by the short side of their table, a query skips every machine whose
+    // short side is below the part short side with one binary search before checking the rest
+    class EligibilityIndex
+    {
+    public:
+        EligibilityIndex() = default;
+
+        explicit EligibilityIndex(const std::map<MachineID, Machine>& machines)
+        {
+            build(machines);
+        }
+
+        // machines must outlive the index and not be inserted or erased while it is used
+        void build(const std::map<MachineID, Machine>& machines)
+        {
+            for (auto& entries : by_type_) entries.clear();
+            for (const auto& [mid, m] : machines)
+            {
+                const auto type = static_cast<size_t>(m.machineType);
+                if (type >= by_type_.size()) continue;
+                by_type_[type].push_back(Entry{
+                    std::min(m.workEnvelope.X, m.workEnvelope.Y), std::max(m.workEnvelope.X, m.workEnvelope.Y),
+                    m.workEnvelope.Z, &m
+                });
+            }
+            for (auto& entries : by_type_)
+            {
+                std::sort(entries.begin(), entries.end(),
+                          [](const Entry& a, const Entry& b) { return a.short_side < b.short_side; });
+            }
+        }
+
+        // calls f(machine) for every machine that can run op with its part, in table size order
+        template <typename F>
+        void for_each_eligible(const Operation& op, const SizeXYZ* part_size, F&& f) const
+        {
+            const auto type = static_cast<size_t>(op.requiredMachine);
+            if (type >= by_type_.size()) return;
+            const auto& entries = by_type_[type];
+            const float part_short = part_size ? std::min(part_size->X, part_size->Y) : 0.f;
+            const float part_long = part_size ? std::max(part_size->X, part_size->Y) : 0.f;
+            const float part_z = part_size ? part_size->Z : 0.f;
+            auto it = std::lower_bound(entries.begin(), entries.end(), part_short,
+                                       [](const Entry& e, float v) { return e.short_side < v; });
+            for (; it != entries.end(); ++it)
+            {
+                if (it->long_side < part_long || it->height < part_z) continue;
+                if (!machine_can_run(*it->machine, op)) continue;
+                f(*it->machine);
+            }
+        }
+
+    private:
+        struct Entry
+        {
+            float short_side;
+            float long_side;
+            float height;
+            const Machine* machine;
+        };
+
+        std::array<std::vector<Entry>, static_cast<size_t>(MachineType::count)> by_type_;
+    };
+
+    // size of the part op machines, nullptr when the part is unknown
+    inline const SizeXYZ* part_size_of(const ProductionState& state, const Operation& op)
+    {
+        auto it = state.parts.find(op.partId);
+        return it != state.parts.end() ? &it->second.partSize : nullptr;
+    }
+
     struct ScheduledOp
     {
         OperationID op_id = -1;
@@ -35,6 +164,157 @@ namespace OptiProSimple
         double end = 0.0;
     };
 
+    // due date of a part in plan time (0 is state.time) and the weight of being late
+    struct DueDate
+    {
+        double due = std::numeric_limits<double>::infinity();
+        double weight = 1.0;
+    };
+
+    // a part is due with the earliest open job using it and weighs as much as the most urgent one
+    inline std::unordered_map<PartID, DueDate> part_due_dates(const ProductionState& state)
+    {
+        std::unordered_map<PartID, DueDate> dues;
+        for (const auto& [jobId, job] : state.jobs)
+        {
+            if (job.state == State::completed || !(job.dueTime < std::numeric_limits<double>::infinity())) continue;
+            for (const auto& [partId, qty] : job.parts)
+            {
+                auto [it, inserted] = dues.try_emplace(partId);
+                it->second.due = std::min(it->second.due, job.dueTime - state.time);
+                it->second.weight = inserted
+                                        ? priorityWeight(job.priority)
+                                        : std::max(it->second.weight, priorityWeight(job.priority));
+            }
+        }
+        return dues;
+    }
+
+    struct TardinessStats
+    {
+        double weighted_tardiness = 0.0;
+        int due_jobs = 0; // planned jobs with a due date
+        int late_jobs = 0;
+    };
+
+    // jobs finish with the last planned operation of their parts, jobs with nothing planned are left out
+    inline TardinessStats schedule_tardiness(const ProductionState& state, const std::vector<ScheduledOp>& schedule)
+    {
+        TardinessStats stats;
+        std::unordered_map<PartID, double> part_end;
+        for (const auto& s : schedule)
+        {
+            const PartID part = state.operations.at(s.op_id).partId;
+            auto [it, inserted] = part_end.try_emplace(part, s.end);
+            if (!inserted) it->second = std::max(it->second, s.end);
+        }
+        for (const auto& [jobId, job] : state.jobs)
+        {
+            if (job.state == State::completed || !(job.dueTime < std::numeric_limits<double>::infinity())) continue;
+            double end = -1.0;
+            for (const auto& [partId, qty] : job.parts)
+            {
+                auto it = part_end.find(partId);
+                if (it != part_end.end()) end = std::max(end, it->second);
+            }
+            if (end < 0.0) continue;
+            ++stats.due_jobs;
+            const double late = end - (job.dueTime - state.time);
+            if (late <= 0.0) continue;
+            ++stats.late_jobs;
+            stats.weighted_tardiness += priorityWeight(job.priority) * late;
+        }
+        return stats;
+    }
+
+    // value of the configured objective, lower is better
+    inline double schedule_objective(const ProductionState& state, const std::vector<ScheduledOp>& schedule,
+                                     const ScheduleOptions& options)
+    {
+        if (options.objective == ScheduleObjective::makespan)
+        {
+            double makespan = 0.0;
+            for (const auto& s : schedule) makespan = std::max(makespan, s.end);
+            return makespan;
+        }
+        const auto stats = schedule_tardiness(state, schedule);
+        if (options.objective == ScheduleObjective::on_time)
+            return stats.late_jobs + stats.weighted_tardiness / (1.0 + stats.weighted_tardiness);
+        return stats.weighted_tardiness;
+    }
+
+    // machine each queued operation waits on, the anchors of a change minimising replan
+    inline std::unordered_map<OperationID, MachineID> queued_machines(const ProductionState& state)
+    {
+        std::unordered_map<OperationID, MachineID> anchors;
+        for (const auto& [mid, m] : state.machines)
+        {
+            for (auto q = m.operations; !q.empty(); q.pop()) anchors[q.front()] = mid;
+        }
+        return anchors;
+    }
+
+    // both plans on the same clock, the engine keeps its plans in simulated seconds
+    inline ScheduleDiff diff_schedules(const std::vector<ScheduledOp>& before, const std::vector<ScheduledOp>& after)
+    {
+        ScheduleDiff diff;
+        // machine, start and the operation before it on that machine
+        struct Slot
+        {
+            MachineID machine;
+            double start;
+            OperationID previous;
+        };
+        auto slots = [](const std::vector<ScheduledOp>& schedule)
+        {
+            std::vector<const ScheduledOp*> ordered;
+            ordered.reserve(schedule.size());
+            for (const auto& s : schedule) ordered.push_back(&s);
+            std::stable_sort(ordered.begin(), ordered.end(),
+                             [](const ScheduledOp* a, const ScheduledOp* b) { return a->start < b->start; });
+            std::unordered_map<MachineID, OperationID> last;
+            std::unordered_map<OperationID, Slot> out;
+            out.reserve(schedule.size());
+            for (const auto* s : ordered)
+            {
+                auto [it, inserted] = last.try_emplace(s->machine_id, -1);
+                out[s->op_id] = Slot{s->machine_id, s->start, it->second};
+                it->second = s->op_id;
+            }
+            return out;
+        };
+        const auto old_slots = slots(before);
+        const auto new_slots = slots(after);
+        double shift_total = 0.0;
+        for (const auto& [opid, slot] : new_slots)
+        {
+            auto it = old_slots.find(opid);
+            if (it == old_slots.end())
+            {
+                ++diff.added;
+                continue;
+            }
+            ++diff.kept;
+            if (slot.machine != it->second.machine) ++diff.moved;
+            else if (slot.previous != it->second.previous) ++diff.resequenced;
+            const double shift = std::abs(slot.start - it->second.start);
+            shift_total += shift;
+            diff.maxStartShift = std::max(diff.maxStartShift, shift);
+        }
+        diff.removed = static_cast<int>(old_slots.size()) - diff.kept;
+        if (diff.kept > 0) diff.meanStartShift = shift_total / diff.kept;
+        return diff;
+    }
+
+    // dispatch key of an operation that must start by latest_start, lower runs first
+    // weighted tardiness divides the slack by the weight while there is some and multiplies the lateness after
+    inline double dispatch_key(double latest_start, double weight, ScheduleObjective objective)
+    {
+        if (objective == ScheduleObjective::weighted_tardiness)
+            return latest_start >= 0.0 ? latest_start / weight : latest_start * weight;
+        return latest_start;
+    }
+
     struct Arc
     {
         int src_idx = -1;
@@ -83,6 +363,13 @@ namespace OptiProSimple
                 if (ui >= 0 && vi >= 0) break;
             }
             if (ui < 0 || vi < 0) return nullptr;
+            return insert_arc(ui, vi);
+        }
+
+        // arc between node indices, callers that built the nodes already know them
+        Arc* insert_arc(int ui, int vi)
+        {
+            if (ui < 0 || vi < 0 || ui >= (int)nodes.size() || vi >= (int)nodes.size()) return nullptr;
             auto a = std::make_unique<Arc>();
             a->src_idx = ui;
             a->tgt_idx = vi;
@@ -111,17 +398,143 @@ namespace OptiProSimple
             {
                 OperationID prev = part.operations[i - 1];
                 OperationID cur = part.operations[i];
-                int u = g.opid_to_index[prev];
-                int v = g.opid_to_index[cur];
-                g.insert_arc(g.nodes[u].get(), g.nodes[v].get());
+                g.insert_arc(g.opid_to_index[prev], g.opid_to_index[cur]);
             }
         }
     }
 
+    // graph over the operations not completed yet, consecutive open operations of a part are linked
+    // completed ones head their routing so no precedence is lost
+    inline void build_graph_from_open_ops(const ProductionState& state, Graph& g)
+    {
+        g.clear();
+        for (const auto& [partId, part] : state.parts)
+        {
+            if (part.state == State::completed) continue;
+            int prev = -1;
+            for (OperationID opid : part.operations)
+            {
+                auto itop = state.operations.find(opid);
+                if (itop == state.operations.end() || itop->second.completed) continue;
+                g.insert_node(opid);
+                const int cur = static_cast<int>(g.nodes.size()) - 1;
+                if (prev >= 0) g.insert_arc(prev, cur);
+                prev = cur;
+            }
+        }
+    }
+
+    // optimizer view of every machine, starting with the tools it currently carries
+    inline std::vector<OptMachine> build_opt_machines(const ProductionState& state)
+    {
+        std::vector<OptMachine> machines;
+        machines.reserve(state.machines.size());
+        for (const auto& [mid, mdata] : state.machines)
+        {
+            OptMachine om;
+            om.machine_id = mid;
+            om.available = (mdata.status != MachineState::error);
+            om.available_time = 0.0;
+            om.magazine = ToolMagazine::fromMachine(mdata);
+            machines.push_back(std::move(om));
+        }
+        return machines;
+    }
+
+    // setup time of op when it follows whatever left the magazine loaded
+    // missing tools are charged proportionally plus their tool change, a fully loaded machine only pays the residual
+    inline double effective_setup_time(const Operation& op, const ToolMagazine& magazine, int last_family,
+                                       int last_fixture, const ScheduleOptions& options = {})
+    {
+        // the rest of a packed table runs on the setup of the first part
+        if (op.fixtureGroup >= 0 && op.fixtureGroup == last_fixture) return 0.0;
+        const double setup = static_cast<double>(op.setupTime);
+        if (!options.sequence_dependent_setup) return setup;
+
+        double missing_fraction;
+        size_t missing = 0;
+        if (op.tools.empty())
+        {
+            missing_fraction = (op.setupFamily >= 0 && op.setupFamily == last_family) ? 0.0 : 1.0;
+        }
+        else
+        {
+            missing = magazine.missing(op);
+            missing_fraction = static_cast<double>(missing) / static_cast<double>(op.tools.size());
+        }
+        const double residual = options.residual_setup_fraction;
+        return setup * (residual + (1.0 - residual) * missing_fraction) +
+            static_cast<double>(missing) * options.tool_change_time;
+    }
+
+    // processing time of op with the setup it would need after the given machine state
+    inline double effective_duration(const Operation& op, const ToolMagazine& magazine, int last_family,
+                                     int last_fixture, const ScheduleOptions& options = {})
+    {
+        return effective_setup_time(op, magazine, last_family, last_fixture, options) +
+            static_cast<double>(op.machineTime) * static_cast<double>(op.quantity);
+    }
+
+    // key shared by operations that need the same setup (machine type and tool set)
+    inline uint64_t setup_signature(const Operation& op)
+    {
+        if (op.fixtureGroup >= 0) return (uint64_t{1} << 63) | static_cast<uint64_t>(op.fixtureGroup);
+        uint64_t h = static_cast<uint64_t>(op.requiredMachine) + 1;
+        for (ToolID t : op.tools) h = (h * 1000003u) ^ static_cast<uint64_t>(t + 1);
+        if (op.tools.empty()) h = (h * 1000003u) ^ static_cast<uint64_t>(op.setupFamily + 2);
+        return h;
+    }
+
     // Schedule using ProductionState to determine durations and compatible machines
+    // machine index among allowed with the earliest completion of op, the setup depends on what each machine
+    // has loaded, ties go to the earliest start; fixture_mi >= 0 pins the choice, -1 when nothing can run it
+    // machines other than anchor count options.stability_penalty seconds later when comparing
+    inline int earliest_completion(const Operation& op, double pred_max, const std::vector<int>& allowed,
+                                   const std::vector<OptMachine>& machines, int fixture_mi,
+                                   const ScheduleOptions& options, double& start, double& end,
+                                   MachineID anchor = -1)
+    {
+        int chosen = -1;
+        double best_start = 1e300;
+        double best_end = 1e300;
+        double best_key = 1e300;
+        for (int mi : allowed)
+        {
+            const auto& optm = machines[mi];
+            if (!optm.available) continue;
+            if (fixture_mi >= 0 && mi != fixture_mi) continue;
+            const double candidate = std::max(optm.available_time, pred_max);
+            const double candidate_end = candidate + effective_duration(op, optm.magazine, optm.last_family,
+                                                                        optm.last_fixture, options);
+            const double key = anchor >= 0 && optm.machine_id != anchor
+                                   ? candidate_end + options.stability_penalty
+                                   : candidate_end;
+            if (key < best_key || (key == best_key && candidate < best_start))
+            {
+                best_start = candidate;
+                best_end = candidate_end;
+                best_key = key;
+                chosen = mi;
+            }
+        }
+        start = best_start;
+        end = best_end;
+        return chosen;
+    }
+
+    // machine state after op ran on it until end
+    inline void commit_placement(OptMachine& machine, const Operation& op, double end)
+    {
+        machine.available_time = end;
+        machine.magazine.load(op);
+        machine.last_family = op.setupFamily;
+        machine.last_fixture = op.fixtureGroup;
+    }
+
     inline std::vector<ScheduledOp> schedule_orders(Graph& g, std::vector<OptMachine>& machines,
                                                     const ProductionState& state, double start_time = 0.0,
-                                                    const std::unordered_map<int, double>& completed_node_end = {})
+                                                    const std::unordered_map<int, double>& completed_node_end = {},
+                                                    const ScheduleOptions& options = {})
     {
         std::vector<ScheduledOp> schedule;
         int n = (int)g.nodes.size();
@@ -137,10 +550,91 @@ namespace OptiProSimple
             }
         }
 
-        std::queue<int> q;
+        // ready operations in release order, or by due date under the tardiness objectives,
+        // plus per setup buckets when batching
+        std::deque<int> ready;
+        using Keyed = std::pair<std::pair<double, int>, int>; // (key, arrival), node
+        std::priority_queue<Keyed, std::vector<Keyed>, std::greater<Keyed>> keyed;
+        const bool by_due = options.objective != ScheduleObjective::makespan;
+        const auto dues = by_due ? part_due_dates(state) : std::unordered_map<PartID, DueDate>{};
+        int arrivals = 0;
+        std::unordered_map<uint64_t, std::deque<int>> setup_buckets;
+        std::vector<uint64_t> signature(n, 0);
+        std::vector<char> taken(n, 0);
+        auto push_ready = [&](int i)
+        {
+            const auto& ready_op = state.operations.at(g.nodes[i]->opid);
+            if (by_due)
+            {
+                // latest start that still meets the due date with the nominal times of the rest of the part
+                double key = std::numeric_limits<double>::infinity();
+                auto itdue = dues.find(ready_op.partId);
+                if (itdue != dues.end())
+                {
+                    double latest = itdue->second.due;
+                    const auto& route = state.parts.at(ready_op.partId).operations;
+                    for (auto it = route.rbegin(); it != route.rend(); ++it)
+                    {
+                        const auto& later = state.operations.at(*it);
+                        latest -= static_cast<double>(later.setupTime) +
+                            static_cast<double>(later.machineTime) * later.quantity;
+                        if (*it == ready_op.id) break;
+                    }
+                    key = dispatch_key(latest, itdue->second.weight, options.objective);
+                }
+                keyed.push({{key, arrivals++}, i});
+            }
+            else ready.push_back(i);
+            if (options.batch_setups || ready_op.fixtureGroup >= 0)
+            {
+                signature[i] = setup_signature(ready_op);
+                setup_buckets[signature[i]].push_back(i);
+            }
+        };
+        bool has_last_signature = false;
+        uint64_t last_signature = 0;
+        auto pop_ready = [&]() -> int
+        {
+            if (has_last_signature)
+            {
+                auto bit = setup_buckets.find(last_signature);
+                while (bit != setup_buckets.end() && !bit->second.empty())
+                {
+                    int i = bit->second.front();
+                    bit->second.pop_front();
+                    if (!taken[i])
+                    {
+                        taken[i] = 1;
+                        return i;
+                    }
+                }
+            }
+            while (!ready.empty())
+            {
+                int i = ready.front();
+                ready.pop_front();
+                if (!taken[i])
+                {
+                    taken[i] = 1;
+                    return i;
+                }
+            }
+            while (!keyed.empty())
+            {
+                int i = keyed.top().second;
+                keyed.pop();
+                if (!taken[i])
+                {
+                    taken[i] = 1;
+                    return i;
+                }
+            }
+            return -1;
+        };
+
         for (int i = 0; i < n; ++i)
         {
-            if (completed_node_end.find(i) == completed_node_end.end() && indeg[i] == 0) q.push(i);
+            if (completed_node_end.find(i) == completed_node_end.end() && indeg[i] == 0) push_ready(i);
         }
 
         // for quick machine lookup by id
@@ -149,6 +643,13 @@ namespace OptiProSimple
 
         for (auto& m : machines) if (m.available) m.available_time = std::max(m.available_time, start_time);
 
+        std::unordered_map<int, int> fixture_machine;
+        const EligibilityIndex eligibility(state.machines);
+        const auto anchors = options.stability_penalty > 0.0
+                                 ? queued_machines(state)
+                                 : std::unordered_map<OperationID, MachineID>{};
+        std::vector<int> allowed_machines;
+
         // map node -> end_time (for preds)
         std::vector<double> node_end(n, -1.0);
         for (const auto& kv : completed_node_end)
@@ -160,73 +661,50 @@ namespace OptiProSimple
             }
         }
 
-        while (!q.empty())
+        for (int idx = pop_ready(); idx >= 0; idx = pop_ready())
         {
-            int idx = q.front();
-            q.pop();
             OperationID opid = g.nodes[idx]->opid;
             const auto& op = state.operations.at(opid);
 
-            // compute duration (use totalTime if available)
-            double duration = static_cast<double>(op.totalTime);
-
-            // find compatible machines for this operation
-            std::vector<MachineID> allowed_machines;
-            for (const auto& [mid, mdata] : state.machines)
+            // find compatible machines for this operation, including envelope fit
+            allowed_machines.clear();
+            eligibility.for_each_eligible(op, part_size_of(state, op), [&](const Machine& m)
             {
-                if (mdata.machineType != op.requiredMachine) continue;
-                // check required specs subset
-                bool ok = true;
-                for (const auto& spec : op.requiredMachineSpces)
-                {
-                    if (mdata.machineSpecs.find(spec) == mdata.machineSpecs.end())
-                    {
-                        ok = false;
-                        break;
-                    }
-                }
-                if (ok) allowed_machines.push_back(mid);
-            }
-
-            // choose machine with earliest start
-            MachineID chosen_mid = -1;
-            double best_start = 1e300;
-            int chosen_mi = -1;
-            for (MachineID mid : allowed_machines)
+                auto it = machine_index.find(m.id);
+                if (it != machine_index.end()) allowed_machines.push_back(it->second);
+            });
+
+            double pred_max = 0.0;
+            for (int p : g.nodes[idx]->pred) if (node_end[p] >= 0) pred_max = std::max(pred_max, node_end[p]);
+            // members of a packed table stay on the machine that got the first one
+            int fixture_mi = -1;
+            if (op.fixtureGroup >= 0)
             {
-                auto it = machine_index.find(mid);
-                if (it == machine_index.end()) continue;
-                int mi = it->second;
-                auto& optm = machines[mi];
-                if (!optm.available) continue;
-                double machine_av = optm.available_time;
-                double pred_max = 0.0;
-                for (int p : g.nodes[idx]->pred) if (node_end[p] >= 0) pred_max = std::max(pred_max, node_end[p]);
-                double candidate = std::max(machine_av, pred_max);
-                if (candidate < best_start)
-                {
-                    best_start = candidate;
-                    chosen_mid = mid;
-                    chosen_mi = mi;
-                }
+                auto itfix = fixture_machine.find(op.fixtureGroup);
+                if (itfix != fixture_machine.end() && machines[itfix->second].available) fixture_mi = itfix->second;
             }
-
-            if (chosen_mid < 0)
+            double start = 0.0;
+            double end = 0.0;
+            auto itanchor = anchors.find(opid);
+            const int chosen_mi = earliest_completion(op, pred_max, allowed_machines, machines, fixture_mi, options,
+                                                      start, end, itanchor != anchors.end() ? itanchor->second : -1);
+            if (chosen_mi < 0)
             {
                 continue;
             }
 
-            double start = best_start;
-            double end = start + duration;
-            schedule.push_back(ScheduledOp{opid, chosen_mid, start, end});
+            schedule.push_back(ScheduledOp{opid, machines[chosen_mi].machine_id, start, end});
             node_end[idx] = end;
-            machines[chosen_mi].available_time = end;
+            commit_placement(machines[chosen_mi], op, end);
+            if (op.fixtureGroup >= 0) fixture_machine[op.fixtureGroup] = chosen_mi;
+            has_last_signature = options.batch_setups || op.fixtureGroup >= 0;
+            last_signature = signature[idx];
 
             for (int s : g.nodes[idx]->succ)
             {
                 if (completed_node_end.find(s) != completed_node_end.end()) continue;
                 indeg[s]--;
-                if (indeg[s] == 0) q.push(s);
+                if (indeg[s] == 0) push_ready(s);
             }
         }
 
@@ -234,10 +712,11 @@ namespace OptiProSimple
     }
 
     // Handler de fallo de máquina: marca caída y replanifica desde now
+    // now and prior_schedule share a clock, schedule_orders plans start at 0 so pass the seconds since that plan
     inline std::vector<ScheduledOp> handle_machine_failure(Graph& g, std::vector<OptMachine>& machines,
                                                            const std::vector<ScheduledOp>& prior_schedule,
                                                            const ProductionState& state, MachineID failed_machine_id,
-                                                           double now)
+                                                           double now, const ScheduleOptions& options = {})
     {
         for (auto& m : machines)
         {
@@ -259,6 +738,6 @@ namespace OptiProSimple
 
         for (auto& m : machines) if (m.available) m.available_time = std::max(m.available_time, now);
 
-        return schedule_orders(g, machines, state, now, completed_node_end);
+        return schedule_orders(g, machines, state, now, completed_node_end, options);
     }
 }
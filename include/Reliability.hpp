@@ -0,0 +1,174 @@
+//
+// Machine failure and repair times, pre-sampled as events on the simulation clock
+//
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <optional>
+#include <queue>
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "types.hpp"
+
+// seconds until the next failure or until a repair is done
+struct LifeDistribution
+{
+    enum class Kind
+    {
+        exponential, // memoryless, random shocks
+        weibull // shape > 1 wears out, shape < 1 fails early
+    };
+
+    Kind kind = Kind::exponential;
+    double mean = std::numeric_limits<double>::infinity(); // infinity never happens
+    double shape = 1.0;
+
+    static LifeDistribution exponential(double mean)
+    {
+        return LifeDistribution{Kind::exponential, mean, 1.0};
+    }
+
+    static LifeDistribution weibull(double mean, double shape)
+    {
+        return LifeDistribution{Kind::weibull, mean, shape};
+    }
+
+    template <class Rng>
+    double sample(Rng& rng) const
+    {
+        if (!std::isfinite(mean)) return std::numeric_limits<double>::infinity();
+        if (mean <= 0.0) return 0.0;
+        if (kind == Kind::weibull && shape > 0.0)
+        {
+            // mean = scale * gamma(1 + 1 / shape)
+            const double scale = mean / std::tgamma(1.0 + 1.0 / shape);
+            return std::weibull_distribution<double>(shape, scale)(rng);
+        }
+        return std::exponential_distribution<double>(1.0 / mean)(rng);
+    }
+};
+
+// mtbf and mttr of one kind of machine
+struct ReliabilityProfile
+{
+    LifeDistribution failure;
+    LifeDistribution repair;
+};
+
+// profiles by machine type and size class, machines without one use the fallback
+struct ReliabilityModel
+{
+    ReliabilityProfile fallback{LifeDistribution::weibull(8 * 3600.0, 1.5), LifeDistribution::exponential(20 * 60.0)};
+    std::map<std::pair<MachineType, MachineSizeClass>, ReliabilityProfile> profiles;
+
+    void set(MachineType type, MachineSizeClass size, const ReliabilityProfile& profile)
+    {
+        profiles[{type, size}] = profile;
+    }
+
+    // every size class of the type
+    void set(MachineType type, const ReliabilityProfile& profile)
+    {
+        for (auto size : {MachineSizeClass::Small, MachineSizeClass::Medium, MachineSizeClass::Large})
+            set(type, size, profile);
+    }
+
+    const ReliabilityProfile& profile(const Machine& machine) const
+    {
+        auto it = profiles.find({machine.machineType, machine.sizeClass});
+        return it != profiles.end() ? it->second : fallback;
+    }
+
+    // large machines take twice as long to repair, no failures at all with never()
+    static ReliabilityModel defaults()
+    {
+        ReliabilityModel model;
+        for (int t = 0; t < static_cast<int>(MachineType::count); ++t)
+        {
+            auto large = model.fallback;
+            large.repair.mean *= 2.0;
+            model.set(static_cast<MachineType>(t), MachineSizeClass::Large, large);
+        }
+        return model;
+    }
+
+    static ReliabilityModel never()
+    {
+        ReliabilityModel model;
+        model.fallback = ReliabilityProfile{};
+        return model;
+    }
+};
+
+// pending failures and repairs by time, a machine has at most one live event
+// cancel invalidates the live one lazily so nothing is searched in the heap
+class FailureEvents
+{
+public:
+    enum class Kind
+    {
+        failure,
+        repair
+    };
+
+    struct Event
+    {
+        double time;
+        MachineID machine;
+        Kind kind;
+        uint64_t epoch;
+    };
+
+    // replaces the live event of the machine
+    void schedule(double time, MachineID mid, Kind kind)
+    {
+        const uint64_t epoch = ++epochs_[mid];
+        if (std::isfinite(time)) events_.push(Event{time, mid, kind, epoch});
+    }
+
+    void cancel(MachineID mid)
+    {
+        ++epochs_[mid];
+    }
+
+    void clear()
+    {
+        events_ = {};
+        epochs_.clear();
+    }
+
+    // time of the earliest event, a cancelled one can make it early but never late
+    double next() const
+    {
+        return events_.empty() ? std::numeric_limits<double>::infinity() : events_.top().time;
+    }
+
+    // earliest live event due at now, the cancelled ones are dropped on the way
+    std::optional<Event> pop(double now)
+    {
+        while (!events_.empty() && events_.top().time <= now)
+        {
+            const Event event = events_.top();
+            events_.pop();
+            if (event.epoch == epochs_[event.machine]) return event;
+        }
+        return std::nullopt;
+    }
+
+private:
+    struct Later
+    {
+        bool operator()(const Event& a, const Event& b) const
+        {
+            return a.time > b.time;
+        }
+    };
+
+    std::priority_queue<Event, std::vector<Event>, Later> events_;
+    std::unordered_map<MachineID, uint64_t> epochs_;
+};
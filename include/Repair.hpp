@@ -0,0 +1,283 @@
+//
+// Plan repair after a machine stop, only the work of the stopped machine moves
+//
+#pragma once
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Optimizer.hpp"
+
+namespace OptiProSimple
+{
+    struct RepairOptions
+    {
+        // seconds of right shift forced on the next queued operation count this much against
+        // the completion of the moved one, higher keeps the rest of the plan stiller
+        double shift_weight = 1.0;
+    };
+
+    struct RepairResult
+    {
+        // new queue of every machine that received work, in run order, the others keep theirs
+        std::unordered_map<MachineID, std::vector<OperationID>> queues;
+        // operations no other machine can run, they wait for the stopped one
+        std::vector<OperationID> unplaced;
+        std::vector<ScheduledOp> schedule; // whole plan after the repair, by start
+        size_t moved = 0;
+        size_t shifted = 0; // operations that had to start later
+        bool feasible = true; // false when the queues and the routings form a cycle, nothing is repaired then
+    };
+
+    // queues hold the machine queues in run order, the stopped machine's first entry is the operation it was running
+    // running holds the remaining seconds of the operations in progress on the other machines, they are not in queues
+    // the plan is timed from the queues with nominal durations, then each operation of the stopped machine, by its
+    // planned start, goes to the compatible machine and position minimising its completion plus the weighted shift it
+    // forces on the operation after it. positions only open where it starts before that operation, so the work
+    // already queued keeps its order and is only shifted right, downstream of the change
+    inline RepairResult repair_machine_failure(
+        const ProductionState& state, const std::unordered_map<MachineID, std::vector<OperationID>>& queues,
+        const std::unordered_map<MachineID, std::pair<OperationID, double>>& running, MachineID failed,
+        const RepairOptions& options = {})
+    {
+        RepairResult result;
+
+        // every planned operation gets an index, running ones first on their machine
+        std::vector<OperationID> ids;
+        std::vector<double> duration;
+        std::unordered_map<OperationID, int> index;
+        std::unordered_map<MachineID, int> machine_index;
+        std::vector<MachineID> machine_ids;
+        std::vector<std::vector<int>> sequence;
+        auto add_op = [&](OperationID opid, double d)
+        {
+            index[opid] = static_cast<int>(ids.size());
+            ids.push_back(opid);
+            duration.push_back(d);
+            return static_cast<int>(ids.size()) - 1;
+        };
+        auto machine_slot = [&](MachineID mid)
+        {
+            auto [it, inserted] = machine_index.emplace(mid, static_cast<int>(machine_ids.size()));
+            if (inserted)
+            {
+                machine_ids.push_back(mid);
+                sequence.emplace_back();
+            }
+            return it->second;
+        };
+        for (const auto& [mid, run] : running)
+        {
+            if (mid == failed || index.count(run.first)) continue;
+            sequence[machine_slot(mid)].push_back(add_op(run.first, std::max(0.0, run.second)));
+        }
+        for (const auto& [mid, ops] : queues)
+        {
+            const int m = machine_slot(mid);
+            for (OperationID opid : ops)
+            {
+                const auto& op = state.operations.at(opid);
+                if (op.completed || index.count(opid)) continue;
+                sequence[m].push_back(add_op(opid, static_cast<double>(op.setupTime) +
+                                                   static_cast<double>(op.machineTime) * op.quantity));
+            }
+        }
+        for (const auto& [mid, m] : state.machines) machine_slot(mid);
+
+        // nearest planned predecessor and successor along each routing
+        const int n = static_cast<int>(ids.size());
+        std::vector<int> part_pred(n, -1), part_succ(n, -1);
+        {
+            std::unordered_set<PartID> seen;
+            for (int o = 0; o < n; ++o)
+            {
+                const PartID partId = state.operations.at(ids[o]).partId;
+                if (!seen.insert(partId).second) continue;
+                int prev = -1;
+                for (OperationID opid : state.parts.at(partId).operations)
+                {
+                    auto it = index.find(opid);
+                    if (it == index.end()) continue;
+                    if (prev >= 0)
+                    {
+                        part_pred[it->second] = prev;
+                        part_succ[prev] = it->second;
+                    }
+                    prev = it->second;
+                }
+            }
+        }
+
+        // times of every placed operation from the machine orders and routings, one topological pass
+        // operations off every machine are skipped and do not hold back their successors
+        std::vector<int> machine_of(n, -1), position(n, -1);
+        std::vector<int> indegree(n, 0), ready;
+        std::vector<double> start(n, 0.0), end(n, 0.0);
+        auto machine_succ = [&](int o)
+        {
+            const auto& seq = sequence[machine_of[o]];
+            return position[o] + 1 < static_cast<int>(seq.size()) ? seq[position[o] + 1] : -1;
+        };
+        auto placed_pred = [&](int o) { return part_pred[o] >= 0 && machine_of[part_pred[o]] >= 0; };
+        auto time_plan = [&]()
+        {
+            int placed = 0;
+            ready.clear();
+            for (int o = 0; o < n; ++o)
+            {
+                if (machine_of[o] < 0) continue;
+                ++placed;
+                indegree[o] = placed_pred(o) + (position[o] > 0);
+                if (indegree[o] == 0) ready.push_back(o);
+            }
+            for (size_t r = 0; r < ready.size(); ++r)
+            {
+                const int o = ready[r];
+                double s = 0.0;
+                if (placed_pred(o)) s = std::max(s, end[part_pred[o]]);
+                if (position[o] > 0) s = std::max(s, end[sequence[machine_of[o]][position[o] - 1]]);
+                start[o] = s;
+                end[o] = s + duration[o];
+                const int succ = part_succ[o];
+                if (succ >= 0 && machine_of[succ] >= 0 && --indegree[succ] == 0) ready.push_back(succ);
+                const int next = machine_succ(o);
+                if (next >= 0 && --indegree[next] == 0) ready.push_back(next);
+            }
+            return static_cast<int>(ready.size()) == placed;
+        };
+        for (int m = 0; m < static_cast<int>(sequence.size()); ++m)
+        {
+            for (int k = 0; k < static_cast<int>(sequence[m].size()); ++k)
+            {
+                machine_of[sequence[m][k]] = m;
+                position[sequence[m][k]] = k;
+            }
+        }
+        if (!time_plan())
+        {
+            result.feasible = false;
+            return result;
+        }
+        const std::vector<double> planned_start = start;
+
+        // the stopped machine's work, earliest planned first so routing predecessors are placed before
+        const int failed_m = machine_slot(failed);
+        std::vector<int> moving = sequence[failed_m];
+        sequence[failed_m].clear();
+        std::stable_sort(moving.begin(), moving.end(), [&](int a, int b) { return start[a] < start[b]; });
+        for (int o : moving) machine_of[o] = -1;
+
+        // right shift along the receiving machine, routings downstream are settled by the final pass
+        auto shift_machine = [&](int m, int from)
+        {
+            const auto& seq = sequence[m];
+            for (int k = from; k < static_cast<int>(seq.size()); ++k)
+            {
+                const int o = seq[k];
+                double s = end[seq[k - 1]];
+                if (placed_pred(o)) s = std::max(s, end[part_pred[o]]);
+                if (s <= start[o]) break;
+                start[o] = s;
+                end[o] = s + duration[o];
+            }
+        };
+
+        const EligibilityIndex eligibility(state.machines);
+        std::vector<char> touched(sequence.size(), 0);
+        for (int o : moving)
+        {
+            const auto& op = state.operations.at(ids[o]);
+            // behind an operation that could not move it has to wait for the stopped machine as well
+            if (part_pred[o] >= 0 && machine_of[part_pred[o]] < 0)
+            {
+                result.unplaced.push_back(ids[o]);
+                continue;
+            }
+            // a restarted operation runs in full
+            duration[o] = static_cast<double>(op.setupTime) + static_cast<double>(op.machineTime) * op.quantity;
+            const double release = part_pred[o] >= 0 ? end[part_pred[o]] : 0.0;
+            int best_m = -1;
+            int best_k = 0;
+            double best_cost = 0.0;
+            double best_start = 0.0;
+            eligibility.for_each_eligible(op, part_size_of(state, op), [&](const Machine& machine)
+            {
+                if (machine.id == failed || machine.status == MachineState::error) return;
+                const int m = machine_index.at(machine.id);
+                const auto& seq = sequence[m];
+                // first position whose previous operation ends after the release
+                int k = static_cast<int>(std::partition_point(seq.begin(), seq.end(), [&](int q)
+                {
+                    return end[q] <= release;
+                }) - seq.begin());
+                // an operation in progress stays first
+                if (k == 0 && !seq.empty() && running.count(machine.id) && running.at(machine.id).first == ids[seq[0]])
+                    k = 1;
+                for (; k <= static_cast<int>(seq.size()); ++k)
+                {
+                    const double s = std::max(release, k > 0 ? end[seq[k - 1]] : 0.0);
+                    if (best_m >= 0 && s + duration[o] >= best_cost) break;
+                    if (k < static_cast<int>(seq.size()) && s > start[seq[k]]) continue;
+                    const double push = k < static_cast<int>(seq.size())
+                                            ? std::max(0.0, s + duration[o] - start[seq[k]])
+                                            : 0.0;
+                    const double cost = s + duration[o] + options.shift_weight * push;
+                    if (best_m < 0 || cost < best_cost)
+                    {
+                        best_m = m;
+                        best_k = k;
+                        best_cost = cost;
+                        best_start = s;
+                    }
+                }
+            });
+            if (best_m < 0)
+            {
+                result.unplaced.push_back(ids[o]);
+                continue;
+            }
+            auto& seq = sequence[best_m];
+            seq.insert(seq.begin() + best_k, o);
+            for (int k = best_k; k < static_cast<int>(seq.size()); ++k) position[seq[k]] = k;
+            machine_of[o] = best_m;
+            start[o] = best_start;
+            end[o] = best_start + duration[o];
+            touched[best_m] = 1;
+            ++result.moved;
+            shift_machine(best_m, best_k + 1);
+        }
+        // times downstream of earlier inserts were stale while placing, give up rather than apply a cycle
+        if (!time_plan())
+        {
+            result = RepairResult{};
+            result.feasible = false;
+            return result;
+        }
+        for (int o = 0; o < n; ++o)
+        {
+            if (machine_of[o] >= 0 && start[o] > planned_start[o] + 1e-9) ++result.shifted;
+        }
+
+        for (int m = 0; m < static_cast<int>(sequence.size()); ++m)
+        {
+            if (!touched[m]) continue;
+            auto& out = result.queues[machine_ids[m]];
+            const auto itrun = running.find(machine_ids[m]);
+            for (int o : sequence[m])
+            {
+                if (itrun != running.end() && itrun->second.first == ids[o]) continue;
+                out.push_back(ids[o]);
+            }
+        }
+        result.schedule.reserve(n);
+        for (int o = 0; o < n; ++o)
+        {
+            if (machine_of[o] < 0) continue;
+            result.schedule.push_back(ScheduledOp{ids[o], machine_ids[machine_of[o]], start[o], end[o]});
+        }
+        std::sort(result.schedule.begin(), result.schedule.end(),
+                  [](const ScheduledOp& a, const ScheduledOp& b) { return a.start < b.start; });
+        return result;
+    }
+}
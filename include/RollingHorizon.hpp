@@ -0,0 +1,164 @@
+//
+// Rolling horizon scheduling, only the near future is optimized and the rest is estimated
+//
+#pragma once
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Optimizer.hpp"
+
+namespace OptiProSimple
+{
+    struct HorizonOptions
+    {
+        // operations fully optimized per roll, 0 for no limit
+        size_t window_operations = 2000;
+        // seconds from now covered by the window, 0 for no limit
+        double window_seconds = 0.0;
+        // roll again once this fraction of the window has completed
+        double reroll_fraction = 0.5;
+    };
+
+    // schedule of a roll, the first window_size entries are the optimized window
+    struct HorizonSchedule
+    {
+        std::vector<ScheduledOp> schedule;
+        size_t window_size = 0;
+        double origin = 0.0; // state time the plan times count from
+    };
+
+    // graph over a subset of the operations, arcs only between consecutive operations of a part inside the subset
+    inline void build_graph_from_ops(const ProductionState& state, const std::vector<OperationID>& ops, Graph& g)
+    {
+        g.clear();
+        for (OperationID opid : ops) g.insert_node(opid);
+        std::unordered_map<PartID, int> last_node;
+        for (OperationID opid : ops)
+        {
+            const int v = g.opid_to_index[opid];
+            const PartID part = state.operations.at(opid).partId;
+            auto it = last_node.find(part);
+            if (it != last_node.end()) g.insert_arc(it->second, v);
+            last_node[part] = v;
+        }
+    }
+
+    // list schedule without setups or magazines, each operation goes to the eligible machine free first
+    // order must list the operations of a part in routing order, part_end carries the release of each part
+    inline void approximate_schedule(const std::vector<OperationID>& order, const ProductionState& state,
+                                     const EligibilityIndex& eligibility, std::vector<OptMachine>& machines,
+                                     const std::unordered_map<MachineID, int>& machine_index,
+                                     std::unordered_map<PartID, double>& part_end, std::vector<ScheduledOp>& out)
+    {
+        for (OperationID opid : order)
+        {
+            const auto& op = state.operations.at(opid);
+            const double release = part_end.count(op.partId) ? part_end[op.partId] : 0.0;
+            int chosen = -1;
+            eligibility.for_each_eligible(op, part_size_of(state, op), [&](const Machine& m)
+            {
+                auto it = machine_index.find(m.id);
+                if (it == machine_index.end() || !machines[it->second].available) return;
+                if (chosen < 0 || machines[it->second].available_time < machines[chosen].available_time)
+                    chosen = it->second;
+            });
+            if (chosen < 0)
+            {
+                // nothing can run it, the rest of the part waits forever
+                part_end[op.partId] = 1e300;
+                continue;
+            }
+            auto& m = machines[chosen];
+            const double start = std::max(m.available_time, release);
+            const double end = start + static_cast<double>(op.setupTime) + static_cast<double>(op.machineTime) * op.
+                quantity;
+            if (start >= 1e300) continue;
+            out.push_back(ScheduledOp{opid, m.machine_id, start, end});
+            m.available_time = end;
+            part_end[op.partId] = end;
+        }
+    }
+
+    // order lists every operation still to plan, parts in priority order with their operations in routing order
+    // running holds the operations in progress with their remaining seconds, they are fixed
+    // the window is picked from a cheap estimate of the whole backlog, optimized with schedule_orders
+    // and the operations after it are estimated again from where the window leaves each machine
+    inline HorizonSchedule rolling_horizon_schedule(const ProductionState& state, const std::vector<OperationID>& order,
+                                                    const std::unordered_map<MachineID, std::pair<OperationID, double>>&
+                                                    running, const HorizonOptions& horizon,
+                                                    const ScheduleOptions& options = {})
+    {
+        HorizonSchedule result;
+        const EligibilityIndex eligibility(state.machines);
+        auto base = build_opt_machines(state);
+        std::unordered_map<MachineID, int> machine_index;
+        for (int i = 0; i < static_cast<int>(base.size()); ++i) machine_index[base[i].machine_id] = i;
+        std::unordered_map<PartID, double> running_end;
+        for (const auto& [mid, run] : running)
+        {
+            auto it = machine_index.find(mid);
+            if (it != machine_index.end()) base[it->second].available_time = run.second;
+            running_end[state.operations.at(run.first).partId] = run.second;
+        }
+
+        // estimate of the whole backlog, its start times choose the window
+        std::vector<ScheduledOp> estimate;
+        estimate.reserve(order.size());
+        {
+            auto machines = base;
+            auto part_end = running_end;
+            approximate_schedule(order, state, eligibility, machines, machine_index, part_end, estimate);
+        }
+        std::unordered_set<OperationID> in_window;
+        std::unordered_set<PartID> cut_parts;
+        std::vector<OperationID> window;
+        for (const auto& s : estimate)
+        {
+            const PartID part = state.operations.at(s.op_id).partId;
+            // a part that lost an operation to the tail keeps its later ones there too
+            if (cut_parts.count(part)) continue;
+            const bool full = horizon.window_operations > 0 && window.size() >= horizon.window_operations;
+            if (full || (horizon.window_seconds > 0.0 && s.start >= horizon.window_seconds))
+            {
+                cut_parts.insert(part);
+                continue;
+            }
+            window.push_back(s.op_id);
+            in_window.insert(s.op_id);
+        }
+
+        // optimized window, running operations are in the graph as fixed predecessors
+        std::vector<OperationID> nodes;
+        nodes.reserve(running.size() + window.size());
+        for (const auto& [mid, run] : running) nodes.push_back(run.first);
+        std::vector<OperationID> window_ordered;
+        window_ordered.reserve(window.size());
+        for (OperationID opid : order) if (in_window.count(opid)) window_ordered.push_back(opid);
+        nodes.insert(nodes.end(), window_ordered.begin(), window_ordered.end());
+
+        Graph g;
+        build_graph_from_ops(state, nodes, g);
+        std::unordered_map<int, double> fixed;
+        for (const auto& [mid, run] : running) fixed[g.opid_to_index[run.first]] = run.second;
+        auto machines = base;
+        result.schedule = schedule_orders(g, machines, state, 0.0, fixed, options);
+        result.window_size = result.schedule.size();
+
+        // tail
+        auto part_end = running_end;
+        std::unordered_set<OperationID> placed;
+        for (const auto& s : result.schedule)
+        {
+            const PartID part = state.operations.at(s.op_id).partId;
+            part_end[part] = std::max(part_end[part], s.end);
+            placed.insert(s.op_id);
+        }
+        std::vector<OperationID> tail;
+        tail.reserve(order.size() - placed.size());
+        for (OperationID opid : order) if (!placed.count(opid)) tail.push_back(opid);
+        approximate_schedule(tail, state, eligibility, machines, machine_index, part_end, result.schedule);
+        return result;
+    }
+}
@@ -0,0 +1,304 @@
+//
+// Allocation free evaluation of machine sequence encoded schedules
+//
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "Optimizer.hpp"
+
+namespace OptiProSimple
+{
+    // fixed data of the operations being sequenced, operations are numbered 0..n-1 and job predecessors
+    // should come before their successors so most evaluations settle in one pass
+    struct EvalProblem
+    {
+        int operations = 0;
+        int machines = 0;
+        std::vector<double> duration;
+        std::vector<double> release;
+        std::vector<double> due; // +inf when the operation has no due date
+        std::vector<double> weight;
+        std::vector<int> job_pred; // -1 for the first operation of a part
+        std::vector<OperationID> op_ids;
+        std::vector<MachineID> machine_ids;
+    };
+
+    // candidate schedule as one operation order per machine, compressed rows
+    struct MachineSequence
+    {
+        std::vector<int> offsets; // machines + 1 entries
+        std::vector<int> ops;
+    };
+
+    struct EvalResult
+    {
+        double makespan = 0.0;
+        double total_tardiness = 0.0; // weighted
+        int late = 0; // operations ending after their due date
+        double utilization = 0.0; // busy time over machines * makespan
+        bool feasible = true; // false when the sequences and the routing form a cycle
+    };
+
+    // scratch buffers sized once for a problem, evaluate never allocates after that
+    struct EvalWorkspace
+    {
+        std::vector<double> start;
+        std::vector<double> end;
+        std::vector<int> machine_pred;
+        std::vector<int> indegree;
+        std::vector<int> job_succ_head; // first job successor, routings are chains so one is enough
+        std::vector<int> machine_succ;
+        std::vector<int> ready;
+
+        void reserve(const EvalProblem& problem)
+        {
+            const size_t n = problem.operations;
+            start.assign(n, 0.0);
+            end.assign(n, 0.0);
+            machine_pred.assign(n, -1);
+            indegree.assign(n, 0);
+            job_succ_head.assign(n, -1);
+            machine_succ.assign(n, -1);
+            ready.assign(n, 0);
+        }
+    };
+
+    // start and end of every operation as early as the machine orders and routings allow, one topological pass
+    inline EvalResult evaluate_sequence(const EvalProblem& problem, const MachineSequence& sequence,
+                                        EvalWorkspace& ws)
+    {
+        const int n = problem.operations;
+        std::fill(ws.machine_pred.begin(), ws.machine_pred.end(), -1);
+        std::fill(ws.machine_succ.begin(), ws.machine_succ.end(), -1);
+        std::fill(ws.job_succ_head.begin(), ws.job_succ_head.end(), -1);
+        for (int m = 0; m < problem.machines; ++m)
+        {
+            for (int k = sequence.offsets[m] + 1; k < sequence.offsets[m + 1]; ++k)
+            {
+                ws.machine_pred[sequence.ops[k]] = sequence.ops[k - 1];
+                ws.machine_succ[sequence.ops[k - 1]] = sequence.ops[k];
+            }
+        }
+        int head = 0;
+        int tail = 0;
+        for (int o = 0; o < n; ++o)
+        {
+            const int jp = problem.job_pred[o];
+            if (jp >= 0) ws.job_succ_head[jp] = o;
+            ws.indegree[o] = (jp >= 0) + (ws.machine_pred[o] >= 0);
+            if (ws.indegree[o] == 0) ws.ready[tail++] = o;
+        }
+
+        EvalResult result;
+        double busy = 0.0;
+        while (head < tail)
+        {
+            const int o = ws.ready[head++];
+            double s = problem.release[o];
+            const int jp = problem.job_pred[o];
+            const int mp = ws.machine_pred[o];
+            if (jp >= 0) s = std::max(s, ws.end[jp]);
+            if (mp >= 0) s = std::max(s, ws.end[mp]);
+            ws.start[o] = s;
+            ws.end[o] = s + problem.duration[o];
+            busy += problem.duration[o];
+            result.makespan = std::max(result.makespan, ws.end[o]);
+            const double over = ws.end[o] - problem.due[o];
+            if (over > 0.0)
+            {
+                result.total_tardiness += problem.weight[o] * over;
+                ++result.late;
+            }
+            for (int next : {ws.job_succ_head[o], ws.machine_succ[o]})
+            {
+                if (next >= 0 && --ws.indegree[next] == 0) ws.ready[tail++] = next;
+            }
+        }
+        result.feasible = tail == n;
+        if (!result.feasible) result.makespan = std::numeric_limits<double>::infinity();
+        if (result.makespan > 0.0 && problem.machines > 0)
+            result.utilization = busy / (problem.machines * result.makespan);
+        return result;
+    }
+
+    // many candidates of the same problem side by side, arrays are [operation][lane] so the inner loop over
+    // lanes is contiguous and branch free; index n is a sentinel operation ending at 0 for "no predecessor"
+    template <int Lanes>
+    struct EvalBatch
+    {
+        int operations = 0;
+        std::vector<int> machine_pred; // (n + 1) * Lanes
+        std::vector<double> duration; // (n + 1) * Lanes
+        std::vector<double> end; // (n + 1) * Lanes
+        EvalResult results[Lanes];
+
+        void reserve(const EvalProblem& problem)
+        {
+            operations = problem.operations;
+            const size_t size = static_cast<size_t>(operations + 1) * Lanes;
+            machine_pred.assign(size, operations);
+            duration.assign(size, 0.0);
+            end.assign(size, 0.0);
+        }
+
+        // lane takes the candidate, durations default to the problem ones
+        void load(int lane, const EvalProblem& problem, const MachineSequence& sequence)
+        {
+            const int n = operations;
+            for (int o = 0; o < n; ++o)
+            {
+                machine_pred[o * Lanes + lane] = n;
+                duration[o * Lanes + lane] = problem.duration[o];
+            }
+            for (int m = 0; m < problem.machines; ++m)
+            {
+                for (int k = sequence.offsets[m] + 1; k < sequence.offsets[m + 1]; ++k)
+                {
+                    machine_pred[sequence.ops[k] * Lanes + lane] = sequence.ops[k - 1];
+                }
+            }
+        }
+    };
+
+    // evaluates all lanes with longest path sweeps in operation order, a sweep settles every arc pointing
+    // forward in the numbering so it converges in as many sweeps as the sequences go against it
+    // in a feasible lane nothing can end after all work plus the latest release, a lane passing that has a cycle
+    template <int Lanes>
+    inline void evaluate_batch(const EvalProblem& problem, EvalBatch<Lanes>& batch)
+    {
+        const int n = problem.operations;
+        double* end = batch.end.data();
+        const int* machine_pred = batch.machine_pred.data();
+        const double* duration = batch.duration.data();
+        std::fill(batch.end.begin(), batch.end.end(), 0.0);
+
+        double bound[Lanes];
+        const double latest_release = n > 0 ? *std::max_element(problem.release.begin(), problem.release.end()) : 0.0;
+        std::fill(bound, bound + Lanes, latest_release);
+        for (int o = 0; o < n; ++o)
+        {
+            for (int l = 0; l < Lanes; ++l) bound[l] += duration[static_cast<size_t>(o) * Lanes + l];
+        }
+
+        // growth and latest end per lane, kept as doubles so the lane loops stay plain arithmetic
+        double growth[Lanes];
+        double latest[Lanes];
+        bool cyclic[Lanes];
+        std::fill(cyclic, cyclic + Lanes, false);
+        double v[Lanes];
+        bool any = true;
+        for (int sweep = 0; any && sweep <= n; ++sweep)
+        {
+            std::fill(growth, growth + Lanes, 0.0);
+            std::fill(latest, latest + Lanes, 0.0);
+            for (int o = 0; o < n; ++o)
+            {
+                const int jp = problem.job_pred[o] >= 0 ? problem.job_pred[o] : n;
+                const double release = problem.release[o];
+                const double* job_end = end + static_cast<size_t>(jp) * Lanes;
+                const int* mp = machine_pred + static_cast<size_t>(o) * Lanes;
+                const double* d = duration + static_cast<size_t>(o) * Lanes;
+                // reads and writes of end are split so the gather loop has no stores that could alias it
+                for (int l = 0; l < Lanes; ++l)
+                {
+                    const double machine_end = end[static_cast<size_t>(mp[l]) * Lanes + l];
+                    v[l] = std::max(release, std::max(job_end[l], machine_end)) + d[l];
+                }
+                double* e = end + static_cast<size_t>(o) * Lanes;
+                for (int l = 0; l < Lanes; ++l)
+                {
+                    growth[l] = std::max(growth[l], v[l] - e[l]);
+                    latest[l] = std::max(latest[l], v[l]);
+                    e[l] = v[l];
+                }
+            }
+            any = false;
+            for (int l = 0; l < Lanes; ++l)
+            {
+                cyclic[l] = cyclic[l] || latest[l] > bound[l] * (1.0 + 1e-9);
+                any = any || (growth[l] > 0.0 && !cyclic[l]);
+            }
+        }
+        bool changed[Lanes];
+        for (int l = 0; l < Lanes; ++l) changed[l] = growth[l] > 0.0;
+
+        for (int l = 0; l < Lanes; ++l)
+        {
+            EvalResult& r = batch.results[l];
+            r = EvalResult{};
+            r.feasible = !cyclic[l] && !changed[l];
+            double busy = 0.0;
+            for (int o = 0; o < n; ++o)
+            {
+                const double v = end[static_cast<size_t>(o) * Lanes + l];
+                busy += duration[static_cast<size_t>(o) * Lanes + l];
+                r.makespan = std::max(r.makespan, v);
+                const double over = v - problem.due[o];
+                r.total_tardiness += problem.weight[o] * std::max(0.0, over);
+                r.late += over > 0.0;
+            }
+            if (!r.feasible) r.makespan = std::numeric_limits<double>::infinity();
+            else if (r.makespan > 0.0 && problem.machines > 0)
+                r.utilization = busy / (problem.machines * r.makespan);
+        }
+    }
+
+    // evaluation problem and sequence of a planned schedule, durations are the planned ones
+    // operations are numbered by planned start so routings point forward, the last planned operation of a part
+    // carries the due date of the part
+    inline void encode_schedule(const ProductionState& state, const std::vector<ScheduledOp>& schedule,
+                                EvalProblem& problem, MachineSequence& sequence)
+    {
+        std::vector<const ScheduledOp*> ordered;
+        ordered.reserve(schedule.size());
+        for (const auto& s : schedule) ordered.push_back(&s);
+        std::stable_sort(ordered.begin(), ordered.end(),
+                         [](const ScheduledOp* a, const ScheduledOp* b) { return a->start < b->start; });
+
+        problem = EvalProblem{};
+        problem.operations = static_cast<int>(ordered.size());
+        std::unordered_map<OperationID, int> index;
+        std::unordered_map<MachineID, int> machine_index;
+        for (const auto* s : ordered)
+        {
+            index[s->op_id] = static_cast<int>(problem.op_ids.size());
+            problem.op_ids.push_back(s->op_id);
+            problem.duration.push_back(s->end - s->start);
+            problem.release.push_back(0.0);
+            problem.due.push_back(std::numeric_limits<double>::infinity());
+            problem.weight.push_back(1.0);
+            problem.job_pred.push_back(-1);
+            if (machine_index.emplace(s->machine_id, static_cast<int>(problem.machine_ids.size())).second)
+                problem.machine_ids.push_back(s->machine_id);
+        }
+        problem.machines = static_cast<int>(problem.machine_ids.size());
+        const auto dues = part_due_dates(state);
+        for (const auto& [partId, part] : state.parts)
+        {
+            int prev = -1;
+            for (OperationID opid : part.operations)
+            {
+                auto it = index.find(opid);
+                if (it == index.end()) continue;
+                problem.job_pred[it->second] = prev;
+                prev = it->second;
+            }
+            auto itdue = dues.find(partId);
+            if (prev < 0 || itdue == dues.end()) continue;
+            problem.due[prev] = itdue->second.due;
+            problem.weight[prev] = itdue->second.weight;
+        }
+
+        std::vector<int> count(problem.machines, 0);
+        for (const auto* s : ordered) ++count[machine_index[s->machine_id]];
+        sequence.offsets.assign(problem.machines + 1, 0);
+        for (int m = 0; m < problem.machines; ++m) sequence.offsets[m + 1] = sequence.offsets[m] + count[m];
+        sequence.ops.assign(problem.operations, 0);
+        std::vector<int> fill(sequence.offsets.begin(), sequence.offsets.end() - 1);
+        for (const auto* s : ordered) sequence.ops[fill[machine_index[s->machine_id]]++] = index[s->op_id];
+    }
+}
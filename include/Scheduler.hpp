@@ -0,0 +1,142 @@
+//
+// Optimizer backends behind one entry point, they all return the same schedule format
+//
+#pragma once
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Optimizer.hpp"
+#include "ExactSolver.hpp"
+#include "GeneticScheduler.hpp"
+
+namespace OptiProSimple
+{
+    enum class OptimizerBackend
+    {
+        list, // greedy earliest completion list scheduling
+        exact, // branch and bound on the makespan, cells past ExactOptions limits fall back to list
+        genetic // population search seeded with the list schedule
+    };
+
+    struct BackendOptions
+    {
+        OptimizerBackend backend = OptimizerBackend::list;
+        ExactOptions exact;
+        GeneticOptions genetic;
+    };
+
+    // times the machine orders of a plan with the setups the list scheduler charges, leaving machines as they end
+    // the exact model only knows nominal setups so the times it reports can be optimistic
+    inline std::vector<ScheduledOp> retime_schedule(const Graph& g, std::vector<OptMachine>& machines,
+                                                    const ProductionState& state, double start_time,
+                                                    const std::unordered_map<int, double>& completed_node_end,
+                                                    const ScheduleOptions& options, std::vector<ScheduledOp> plan)
+    {
+        std::stable_sort(plan.begin(), plan.end(),
+                         [](const ScheduledOp& a, const ScheduledOp& b) { return a.start < b.start; });
+        std::unordered_map<MachineID, int> machine_index;
+        for (int i = 0; i < static_cast<int>(machines.size()); ++i)
+        {
+            machine_index[machines[i].machine_id] = i;
+            if (machines[i].available) machines[i].available_time = std::max(machines[i].available_time, start_time);
+        }
+        std::vector<double> node_end(g.nodes.size(), -1.0);
+        for (const auto& [node, end] : completed_node_end)
+        {
+            if (node >= 0 && node < static_cast<int>(node_end.size())) node_end[node] = end;
+        }
+        for (auto& s : plan)
+        {
+            const int node = g.opid_to_index.at(s.op_id);
+            auto& m = machines[machine_index.at(s.machine_id)];
+            const auto& op = state.operations.at(s.op_id);
+            double ready = m.available_time;
+            for (int p : g.nodes[node]->pred) ready = std::max(ready, node_end[p]);
+            s.start = ready;
+            s.end = ready + effective_duration(op, m.magazine, m.last_family, m.last_fixture, options);
+            node_end[node] = s.end;
+            commit_placement(m, op, s.end);
+        }
+        return plan;
+    }
+
+    // objective of a plan plus the stability penalty of every queued operation it moves, like the genetic decode
+    inline double plan_cost(const ProductionState& state, const std::vector<ScheduledOp>& schedule,
+                            const ScheduleOptions& options)
+    {
+        double cost = schedule_objective(state, schedule, options);
+        if (options.stability_penalty <= 0.0 || options.objective == ScheduleObjective::on_time) return cost;
+        const auto anchors = queued_machines(state);
+        int moved = 0;
+        for (const auto& s : schedule)
+        {
+            auto it = anchors.find(s.op_id);
+            if (it != anchors.end() && it->second != s.machine_id) ++moved;
+        }
+        return cost + options.stability_penalty * moved;
+    }
+
+    inline std::vector<ScheduledOp> plan_schedule(Graph& g, std::vector<OptMachine>& machines,
+                                                  const ProductionState& state, double start_time,
+                                                  const std::unordered_map<int, double>& completed_node_end,
+                                                  const ScheduleOptions& options, const BackendOptions& backend)
+    {
+        if (backend.backend == OptimizerBackend::exact &&
+            ExactSolver::fits(g, machines, completed_node_end, backend.exact))
+        {
+            ExactSolver solver(g, machines, state, start_time, completed_node_end, backend.exact);
+            auto result = solver.solve();
+            // nothing found inside the time limit, keep the greedy plan
+            if (!result.schedule.empty())
+            {
+                // the search bounds the makespan without sequence dependent setups, fixture groups or the
+                // stability penalty, so its plan is timed like the list one and both are compared on the objective
+                auto list_machines = machines;
+                auto list = schedule_orders(g, list_machines, state, start_time, completed_node_end, options);
+                auto exact_machines = machines;
+                auto exact = retime_schedule(g, exact_machines, state, start_time, completed_node_end, options,
+                                             std::move(result.schedule));
+                if (plan_cost(state, exact, options) <= plan_cost(state, list, options))
+                {
+                    machines = std::move(exact_machines);
+                    return exact;
+                }
+                machines = std::move(list_machines);
+                return list;
+            }
+        }
+        if (backend.backend == OptimizerBackend::genetic)
+        {
+            auto result = solve_genetic(g, machines, state, start_time, completed_node_end, options, backend.genetic);
+            if (!result.schedule.empty()) return std::move(result.schedule);
+        }
+        return schedule_orders(g, machines, state, start_time, completed_node_end, options);
+    }
+
+    // full plan of everything not started in the state, times count from state.time
+    // running holds the operation in progress and its remaining seconds per machine, they are fixed at their end
+    // and keep the machine busy until then; available_from holds later times machines can take new work from
+    inline std::vector<ScheduledOp> replan_state(
+        const ProductionState& state, const std::unordered_map<MachineID, std::pair<OperationID, double>>& running,
+        const ScheduleOptions& options, const BackendOptions& backend = {},
+        const std::unordered_map<MachineID, double>& available_from = {})
+    {
+        Graph g;
+        build_graph_from_open_ops(state, g);
+        auto machines = build_opt_machines(state);
+        std::unordered_map<int, double> fixed;
+        for (auto& om : machines)
+        {
+            auto itfrom = available_from.find(om.machine_id);
+            if (itfrom != available_from.end()) om.available_time = std::max(om.available_time, itfrom->second);
+            auto itrun = running.find(om.machine_id);
+            if (itrun == running.end()) continue;
+            om.available_time = std::max(om.available_time, itrun->second.second);
+            auto itnode = g.opid_to_index.find(itrun->second.first);
+            if (itnode != g.opid_to_index.end()) fixed[itnode->second] = itrun->second.second;
+        }
+        return plan_schedule(g, machines, state, 0.0, fixed, options, backend);
+    }
+}
@@ -0,0 +1,438 @@
+//
+// Several engines, one per cell and thread, behind a router assigning jobs by capacity and compatibility
+//
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "ConcurrentQueue.hpp"
+#include "Engine.hpp"
+#include "GeneratorUtils.hpp"
+
+struct ShardOptions
+{
+    // seconds of queued work a cell machine is given ahead, the rest waits in the router pool and goes to
+    // whichever cell frees up first, so the backlog follows the capacity that is actually there
+    double release_horizon = 2 * 3600.0;
+    std::chrono::milliseconds router_period{250};
+};
+
+// the router only sees the cells through their snapshots and what it sent since, nothing is shared with
+// the cell threads but the command and update queues
+class ShardedEngine
+{
+public:
+    // cell engines get seeds derived from seed so every cell has its own machines and failures
+    ShardedEngine(int cells, const std::chrono::milliseconds tick_period, std::optional<uint64_t> seed = std::nullopt,
+                  ShardOptions options = {})
+        : options_(options),
+          rng_(seed.value_or(randomSeed()))
+    {
+        for (int c = 0; c < cells; ++c)
+        {
+            cells_.push_back(std::make_unique<Engine>(tick_period, rng_.seed + c + 1));
+            views_.emplace_back();
+        }
+    }
+
+    ~ShardedEngine()
+    {
+        stop();
+    }
+
+    void start()
+    {
+        for (auto& cell : cells_) cell->start();
+        running_ = true;
+        router_ = std::thread(&ShardedEngine::run, this);
+    }
+
+    void stop()
+    {
+        if (running_)
+        {
+            running_ = false;
+            if (router_.joinable()) router_.join();
+        }
+        for (auto& cell : cells_) cell->stop();
+    }
+
+    uint64_t getSeed() const
+    {
+        return rng_.seed;
+    }
+
+    size_t cellCount() const
+    {
+        return cells_.size();
+    }
+
+    Engine& cell(size_t c)
+    {
+        return *cells_.at(c);
+    }
+
+    // same command to every cell, like schedule options or the time scale
+    void broadcast(const CommandVariant& command)
+    {
+        for (auto& cell : cells_) cell->sendCommand(command);
+    }
+
+    // one tool library for the plant so a job can run in any cell with the machines for it
+    void generateShop(int tools, int machinesPerCell)
+    {
+        requests_.push(GenerateShop{tools, machinesPerCell});
+    }
+
+    void generateRandomJobs(int count)
+    {
+        requests_.push(GenerateJobs{count});
+    }
+
+    void submit(JobOrder order)
+    {
+        requests_.push(std::move(order));
+    }
+
+    std::optional<ShardedSnapshot> pollUpdate()
+    {
+        return updates_.try_pop();
+    }
+
+private:
+    struct GenerateShop
+    {
+        int tools;
+        int machinesPerCell;
+    };
+
+    struct GenerateJobs
+    {
+        int count;
+    };
+
+    using Request = std::variant<JobOrder, GenerateJobs, GenerateShop>;
+
+    struct CellView
+    {
+        std::shared_ptr<const StateSnapshot> snapshot;
+        // queued seconds per machine from the snapshot plus the orders sent after it
+        std::unordered_map<MachineID, double> backlog;
+        // the part of backlog the snapshot reported, the router only looks at the pool again when it moves
+        std::unordered_map<MachineID, double> reported;
+        int routed = 0;
+    };
+
+    // pool order: most urgent first, then arrival
+    struct PoolKey
+    {
+        int rank;
+        uint64_t seq;
+
+        bool operator<(const PoolKey& other) const
+        {
+            if (rank != other.rank) return rank < other.rank;
+            return seq < other.seq;
+        }
+    };
+
+    // where an order would go in a cell: each operation on its least loaded compatible machine
+    // missing holds the operations no machine of the cell can run
+    struct Placement
+    {
+        std::vector<OperationID> missing;
+        double wait = 0.0; // largest backlog in front of the order
+        double finish = 0.0; // bottleneck backlog with the order added
+        std::unordered_map<MachineID, double> added;
+    };
+
+    void run()
+    {
+        while (running_)
+        {
+            while (auto request = requests_.try_pop())
+            {
+                std::visit([this](auto&& r) { handle(r); }, *request);
+            }
+            const bool updated = pollCells();
+            generatePending();
+            const bool released = release_wanted_ && release();
+            if (updated || released) publish();
+            std::this_thread::sleep_for(options_.router_period);
+        }
+    }
+
+    void handle(JobOrder& order)
+    {
+        pool_.emplace(PoolKey{3 - priorityLevel(order.job.priority), nextSeq_++}, std::move(order));
+        release_wanted_ = true;
+    }
+
+    // waits for the first snapshots when the shop was just generated
+    void handle(const GenerateJobs& request)
+    {
+        pendingJobs_ += std::max(0, request.count);
+    }
+
+    void generatePending()
+    {
+        if (pendingJobs_ == 0) return;
+        // each routing is drawn against the machines of one cell, taken in turn, so a job always runs whole
+        // somewhere; the router is still free to send it to any other cell able to run it
+        std::vector<GeneratorPools> pools;
+        for (const auto& view : views_)
+        {
+            // a cell still adding the generated machines would get none of the routings
+            if (shopMachines_ > 0 && (!view.snapshot || view.snapshot->productionState.machines.size() < shopMachines_))
+                return;
+            if (!view.snapshot || view.snapshot->productionState.machines.empty()) continue;
+            pools.push_back(buildGeneratorPools({}, view.snapshot->productionState.machines, tools_, routing_));
+        }
+        if (pools.empty() || tools_.empty()) return;
+        const int count = pendingJobs_;
+        pendingJobs_ = 0;
+        for (int i = 0; i < count; ++i)
+        {
+            auto [job, parts, operations, lastJobId, lastPartId, lastOpId] =
+                GenerateRandomJob(rng_.jobs, count, "", nextJobId_, nextPartId_, nextOperationId_,
+                                  pools[i % pools.size()]);
+            nextJobId_ = lastJobId;
+            nextPartId_ = lastPartId;
+            nextOperationId_ = lastOpId;
+            JobOrder order;
+            order.job = std::move(job);
+            for (auto& [id, part] : parts) order.parts.push_back(std::move(part));
+            for (auto& [id, op] : operations) order.operations.push_back(std::move(op));
+            handle(order);
+        }
+    }
+
+    void handle(const GenerateShop& request)
+    {
+        tools_.clear();
+        for (int t = 0; t < request.tools; ++t) tools_[t] = generateRandomTool(t, rng_.tools);
+        broadcast(SetToolLibraryCommand{tools_});
+        broadcast(GenerateRandomMachinesCommand{request.machinesPerCell});
+        shopMachines_ += static_cast<size_t>(std::max(0, request.machinesPerCell));
+    }
+
+    // latest snapshot of every cell, the backlog estimate restarts from it
+    // the pool is released again when some cell reports a backlog other than the last one
+    bool pollCells()
+    {
+        bool updated = false;
+        for (size_t c = 0; c < cells_.size(); ++c)
+        {
+            std::optional<StateSnapshot> latest;
+            while (auto update = cells_[c]->pollUpdate()) latest = std::move(update);
+            if (!latest) continue;
+            auto& view = views_[c];
+            view.snapshot = std::make_shared<const StateSnapshot>(std::move(*latest));
+            std::unordered_map<MachineID, double> reported;
+            const auto& state = view.snapshot->productionState;
+            for (const auto& [mid, m] : state.machines)
+            {
+                double work = 0.0;
+                for (auto q = m.operations; !q.empty(); q.pop())
+                {
+                    auto itop = state.operations.find(q.front());
+                    if (itop != state.operations.end()) work += queuedWork(itop->second);
+                }
+                auto itrt = view.snapshot->runtime.find(mid);
+                if (itrt != view.snapshot->runtime.end()) work += std::max(0.0, itrt->second.remaining_time);
+                reported[mid] = work;
+            }
+            if (reported != view.reported) release_wanted_ = true;
+            view.backlog = reported;
+            view.reported = std::move(reported);
+            updated = true;
+        }
+        return updated;
+    }
+
+    Placement place(const CellView& view, const JobOrder& order) const
+    {
+        Placement placement;
+        const auto& machines = view.snapshot->productionState.machines;
+        std::unordered_map<OperationID, const Operation*> operations;
+        for (const auto& op : order.operations) operations[op.id] = &op;
+        for (const auto& part : order.parts)
+        {
+            for (OperationID opid : part.operations)
+            {
+                auto itop = operations.find(opid);
+                if (itop == operations.end()) continue;
+                const Operation& op = *itop->second;
+                MachineID best = -1;
+                double bestLoad = 0.0;
+                for (const auto& [mid, m] : machines)
+                {
+                    if (!OptiProSimple::machine_can_run(m, op, part.partSize)) continue;
+                    auto itadd = placement.added.find(mid);
+                    const double load = view.backlog.at(mid) + (itadd != placement.added.end() ? itadd->second : 0.0);
+                    if (best < 0 || load < bestLoad)
+                    {
+                        best = mid;
+                        bestLoad = load;
+                    }
+                }
+                if (best < 0)
+                {
+                    placement.missing.push_back(opid);
+                    continue;
+                }
+                const double work = queuedWork(op);
+                placement.wait = std::max(placement.wait, bestLoad);
+                placement.finish = std::max(placement.finish, bestLoad + work);
+                placement.added[best] += work;
+            }
+        }
+        std::sort(placement.missing.begin(), placement.missing.end());
+        return placement;
+    }
+
+    // machines of every cell below the release horizon
+    size_t machinesWithRoom() const
+    {
+        size_t room = 0;
+        for (const auto& view : views_)
+        {
+            for (const auto& [mid, work] : view.backlog) room += work < options_.release_horizon;
+        }
+        return room;
+    }
+
+    // hands pooled orders, most urgent first, to the cell finishing them earliest while it has room
+    // only the cells missing the fewest operations are candidates, what none of them can run waits in the cell
+    // like it would in a single engine and counts the order as unroutable
+    // the count covers the orders scanned before the plant was full
+    bool release()
+    {
+        bool released = false;
+        release_wanted_ = false;
+        unroutable_ = 0;
+        size_t room = machinesWithRoom();
+        std::vector<std::optional<Placement>> placements(views_.size());
+        for (auto it = pool_.begin(); it != pool_.end() && room > 0;)
+        {
+            size_t fewest = std::numeric_limits<size_t>::max();
+            for (size_t c = 0; c < views_.size(); ++c)
+            {
+                placements[c].reset();
+                if (!views_[c].snapshot) continue;
+                placements[c] = place(views_[c], it->second);
+                fewest = std::min(fewest, placements[c]->missing.size());
+            }
+            if (fewest > 0 && fewest != std::numeric_limits<size_t>::max()) ++unroutable_;
+            int bestCell = -1;
+            for (size_t c = 0; c < views_.size(); ++c)
+            {
+                const auto& placement = placements[c];
+                if (!placement || placement->missing.size() != fewest) continue;
+                if (placement->wait >= options_.release_horizon) continue;
+                if (bestCell < 0 || placement->finish < placements[bestCell]->finish) bestCell = static_cast<int>(c);
+            }
+            if (bestCell < 0)
+            {
+                ++it;
+                continue;
+            }
+            auto& view = views_[bestCell];
+            for (const auto& [mid, work] : placements[bestCell]->added)
+            {
+                double& backlog = view.backlog[mid];
+                if (backlog < options_.release_horizon && backlog + work >= options_.release_horizon) --room;
+                backlog += work;
+            }
+            ++view.routed;
+            cells_[bestCell]->sendCommand(AddOrderCommand{std::move(it->second)});
+            it = pool_.erase(it);
+            released = true;
+        }
+        return released;
+    }
+
+    void publish()
+    {
+        ShardedSnapshot out;
+        out.pooledOrders = static_cast<int>(pool_.size());
+        out.unroutableOrders = unroutable_;
+        auto& k = out.kpis;
+        double utilization = 0.0;
+        double availability = 0.0;
+        double flow = 0.0;
+        size_t machines = 0;
+        for (const auto& view : views_)
+        {
+            out.cells.push_back(view.snapshot);
+            out.routed.push_back(view.routed);
+            double backlog = 0.0;
+            for (const auto& [mid, work] : view.backlog) backlog += work;
+            out.backlog.push_back(view.backlog.empty() ? 0.0 : backlog / view.backlog.size());
+            if (!view.snapshot) continue;
+            const auto& c = view.snapshot->kpis;
+            const size_t n = c.utilization.size();
+            k.time = std::max(k.time, c.time);
+            k.makespan = std::max(k.makespan, c.makespan);
+            k.projectedMakespan = std::max(k.projectedMakespan, c.projectedMakespan);
+            utilization += c.averageUtilization * n;
+            availability += c.averageAvailability * n;
+            machines += n;
+            flow += c.averageFlowTime * c.completedJobs;
+            k.completedJobs += c.completedJobs;
+            k.completedOperations += c.completedOperations;
+            k.openJobs += c.openJobs;
+            k.openParts += c.openParts;
+            k.runningOperations += c.runningOperations;
+            k.queuedOperations += c.queuedOperations;
+            for (size_t p = 0; p < k.byPriority.size(); ++p)
+            {
+                auto& a = k.byPriority[p];
+                const auto& b = c.byPriority[p];
+                if (b.withDueDate > 0 && (a.withDueDate == 0 || b.maxLateness > a.maxLateness))
+                    a.maxLateness = b.maxLateness;
+                a.completed += b.completed;
+                a.totalFlowTime += b.totalFlowTime;
+                a.withDueDate += b.withDueDate;
+                a.totalLateness += b.totalLateness;
+                a.late += b.late;
+            }
+        }
+        k.averageUtilization = machines > 0 ? utilization / machines : 0.0;
+        k.averageAvailability = machines > 0 ? availability / machines : 1.0;
+        k.averageFlowTime = k.completedJobs > 0 ? flow / k.completedJobs : 0.0;
+        updates_.push(std::move(out));
+    }
+
+    ShardOptions options_;
+    RngStreams rng_;
+    RoutingConfig routing_;
+    std::vector<std::unique_ptr<Engine>> cells_;
+    std::thread router_;
+    std::atomic<bool> running_{false};
+
+    ConcurrentQueue<Request> requests_;
+    ConcurrentQueue<ShardedSnapshot> updates_;
+
+    // router thread only
+    std::vector<CellView> views_;
+    std::map<PoolKey, JobOrder> pool_;
+    uint64_t nextSeq_ = 0;
+    bool release_wanted_ = false;
+    int unroutable_ = 0;
+    int pendingJobs_ = 0;
+    size_t shopMachines_ = 0; // machines every cell has once the generated shops are in
+    std::map<ToolID, Tool> tools_;
+    int nextJobId_ = 0;
+    int nextPartId_ = 0;
+    int nextOperationId_ = 0;
+};
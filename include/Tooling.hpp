@@ -0,0 +1,148 @@
+//
+// Tool magazine model shared by the optimizer and the engine runtime
+//
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "types.hpp"
+
+// dynamic bitset indexed by ToolID, a membership test is one word lookup
+class ToolBitset
+{
+public:
+    bool test(ToolID id) const
+    {
+        if (id < 0) return false;
+        const size_t w = static_cast<size_t>(id) >> 6;
+        return w < words_.size() && (words_[w] >> (static_cast<size_t>(id) & 63)) & 1u;
+    }
+
+    void set(ToolID id)
+    {
+        if (id < 0) return;
+        const size_t w = static_cast<size_t>(id) >> 6;
+        if (w >= words_.size()) words_.resize(w + 1, 0);
+        words_[w] |= uint64_t{1} << (static_cast<size_t>(id) & 63);
+    }
+
+    void reset(ToolID id)
+    {
+        if (id < 0) return;
+        const size_t w = static_cast<size_t>(id) >> 6;
+        if (w < words_.size()) words_[w] &= ~(uint64_t{1} << (static_cast<size_t>(id) & 63));
+    }
+
+    // number of required tools that are not in the set, O(required)
+    size_t countMissing(const std::set<ToolID>& required) const
+    {
+        size_t missing = 0;
+        for (ToolID t : required) if (!test(t)) ++missing;
+        return missing;
+    }
+
+private:
+    std::vector<uint64_t> words_;
+};
+
+// tools loaded on a machine, slot order matches Machine::tools
+// capacity 0 means the magazine size is unknown and it grows as needed
+struct ToolMagazine
+{
+    std::vector<ToolID> slots; // -1 for an empty slot
+    ToolBitset loaded;
+    uint16_t capacity = 0;
+    size_t cursor = 0; // next slot considered for eviction
+
+    static ToolMagazine fromMachine(const Machine& machine)
+    {
+        ToolMagazine magazine;
+        magazine.capacity = machine.magazineCapacity;
+        size_t size = machine.magazineCapacity;
+        for (const auto& [slot, tool] : machine.tools) size = std::max<size_t>(size, slot + 1);
+        magazine.slots.assign(size, -1);
+        for (const auto& [slot, tool] : machine.tools)
+        {
+            magazine.slots[slot] = tool;
+            magazine.loaded.set(tool);
+        }
+        return magazine;
+    }
+
+    bool fits(const Operation& op) const
+    {
+        return capacity == 0 || op.tools.size() <= capacity;
+    }
+
+    size_t missing(const Operation& op) const
+    {
+        return loaded.countMissing(op.tools);
+    }
+
+    // loads the tools of op, evicting tools op doesnt need in clock order
+    // returns the number of tool changes, written slots are reported through changed
+    template <typename OnChange>
+    size_t load(const Operation& op, OnChange&& changed)
+    {
+        size_t changes = 0;
+        for (ToolID t : op.tools)
+        {
+            if (loaded.test(t)) continue;
+            size_t slot = slots.size();
+            for (size_t i = 0; i < slots.size(); ++i)
+            {
+                if (slots[i] < 0)
+                {
+                    slot = i;
+                    break;
+                }
+            }
+            if (slot == slots.size() && capacity != 0 && !slots.empty())
+            {
+                // magazine full, evict the next tool the operation doesnt use
+                for (size_t n = 0; n < slots.size(); ++n)
+                {
+                    size_t i = (cursor + n) % slots.size();
+                    if (op.tools.find(slots[i]) == op.tools.end())
+                    {
+                        slot = i;
+                        cursor = (i + 1) % slots.size();
+                        break;
+                    }
+                }
+                if (slot == slots.size()) break; // everything loaded is needed, fits() prevents this
+            }
+            if (slot == slots.size()) slots.push_back(-1);
+            if (slots[slot] >= 0) loaded.reset(slots[slot]);
+            slots[slot] = t;
+            loaded.set(t);
+            changed(static_cast<uint16_t>(slot), t);
+            ++changes;
+        }
+        return changes;
+    }
+
+    size_t load(const Operation& op)
+    {
+        return load(op, [](uint16_t, ToolID)
+        {
+        });
+    }
+};
+
+// magazine size by machine class
+inline uint16_t defaultMagazineCapacity(MachineSizeClass sizeClass)
+{
+    switch (sizeClass)
+    {
+    case MachineSizeClass::Small:
+        return 20;
+    case MachineSizeClass::Medium:
+        return 30;
+    case MachineSizeClass::Large:
+        return 60;
+    default:
+        return 30;
+    }
+}
@@ -0,0 +1,166 @@
+//
+// What-if scenarios planned and simulated on a fork of the live state
+//
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ConcurrentQueue.hpp"
+#include "MonteCarlo.hpp"
+#include "Scheduler.hpp"
+
+namespace OptiProSimple
+{
+    // everything a fork needs from the engine, shared by the scenarios forked together
+    // the state is never written, a scenario that changes it works on its own copy
+    struct ScenarioFork
+    {
+        std::shared_ptr<const ProductionState> state;
+        std::unordered_map<MachineID, std::pair<OperationID, double>> running;
+        ScheduleOptions options;
+        BackendOptions backend;
+        ReliabilityModel reliability;
+        MonteCarloOptions monte_carlo;
+        // the fork planned and run as is, the same for every scenario so only the first one to need it runs it
+        mutable std::once_flag baseline_once;
+        mutable RobustnessReport baseline;
+    };
+
+    inline const RobustnessReport& fork_baseline(const ScenarioFork& fork)
+    {
+        std::call_once(fork.baseline_once, [&fork]()
+        {
+            const auto plan = replan_state(*fork.state, fork.running, fork.options, fork.backend);
+            fork.baseline = monte_carlo_schedule(*fork.state, plan, fork.reliability, fork.monte_carlo);
+        });
+        return fork.baseline;
+    }
+
+    // adds a new job repeating the parts of the source job with fresh part and operation ids
+    // returns false when the source job is unknown
+    inline bool add_rush_order(ProductionState& state, const RushOrder& order)
+    {
+        auto itsource = state.jobs.find(order.sourceJob);
+        if (itsource == state.jobs.end()) return false;
+        const auto sourceParts = itsource->second.parts;
+        Job job = itsource->second;
+        job.jobId = state.jobs.rbegin()->first + 1;
+        job.parts.clear();
+        job.priority = order.priority;
+        job.dueTime = state.time + order.dueIn;
+        job.initialized = false;
+        job.state = State::pending;
+
+        PartID nextPart = state.parts.empty() ? 0 : state.parts.rbegin()->first + 1;
+        OperationID nextOp = state.operations.empty() ? 0 : state.operations.rbegin()->first + 1;
+        for (const auto& [partId, qty] : sourceParts)
+        {
+            auto itpart = state.parts.find(partId);
+            if (itpart == state.parts.end()) continue;
+            Part part = itpart->second;
+            part.id = nextPart++;
+            part.state = State::pending;
+            part.operations.clear();
+            for (OperationID opid : itpart->second.operations)
+            {
+                Operation op = state.operations.at(opid);
+                op.id = nextOp++;
+                op.partId = part.id;
+                op.state = State::pending;
+                op.completed = false;
+                op.fixtureGroup = -1; // not packed with anything yet
+                part.operations.push_back(op.id);
+                state.operations[op.id] = std::move(op);
+            }
+            job.parts[part.id] = qty;
+            state.parts[part.id] = std::move(part);
+        }
+        state.jobs[job.jobId] = std::move(job);
+        return true;
+    }
+
+    // plans and runs the scenario and compares it with the fork as is, both with the same monte carlo seeds
+    // outages starting at the fork are planned around, later ones only hit the running plan
+    inline WhatIfResult evaluate_scenario(const ScenarioFork& fork, const WhatIfScenario& scenario, int id = 0)
+    {
+        const auto started = std::chrono::steady_clock::now();
+        WhatIfResult result;
+        result.id = id;
+        result.name = scenario.name;
+
+        std::shared_ptr<const ProductionState> state = fork.state;
+        if (!scenario.orders.empty())
+        {
+            auto copy = std::make_shared<ProductionState>(*fork.state);
+            for (const auto& order : scenario.orders) add_rush_order(*copy, order);
+            state = std::move(copy);
+        }
+        OutageWindows outages;
+        std::unordered_map<MachineID, double> available_from;
+        for (const auto& outage : scenario.outages)
+        {
+            if (outage.duration <= 0.0) continue;
+            const double end = outage.start + outage.duration;
+            outages[outage.machine].emplace_back(outage.start, end);
+            if (outage.start <= 0.0)
+            {
+                auto [it, inserted] = available_from.try_emplace(outage.machine, end);
+                if (!inserted) it->second = std::max(it->second, end);
+            }
+        }
+        const auto scenario_plan = replan_state(*state, fork.running, fork.options, fork.backend, available_from);
+        result.scenario = monte_carlo_schedule(*state, scenario_plan, fork.reliability, fork.monte_carlo, outages);
+        // after the scenario so the scenarios of a fork plan side by side while one of them runs the baseline
+        result.baseline = fork_baseline(fork);
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        return result;
+    }
+
+    // every scenario runs on its own thread so several can be compared at once, finished ones are polled
+    class ScenarioSandbox
+    {
+    public:
+        int submit(const std::shared_ptr<const ScenarioFork>& fork, WhatIfScenario scenario)
+        {
+            prune();
+            const int id = next_id_++;
+            pending_.push_back(std::async(std::launch::async, [this, fork, scenario = std::move(scenario), id]()
+            {
+                results_.push(evaluate_scenario(*fork, scenario, id));
+            }));
+            return id;
+        }
+
+        std::optional<WhatIfResult> poll()
+        {
+            prune();
+            return results_.try_pop();
+        }
+
+        size_t running() const
+        {
+            return pending_.size();
+        }
+
+    private:
+        void prune()
+        {
+            pending_.erase(std::remove_if(pending_.begin(), pending_.end(), [](const std::future<void>& f)
+            {
+                return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+            }), pending_.end());
+        }
+
+        // results are declared first so the pending evaluations finish before they go
+        ConcurrentQueue<WhatIfResult> results_;
+        std::vector<std::future<void>> pending_;
+        int next_id_ = 1;
+    };
+}
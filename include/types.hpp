@@ -3,6 +3,7 @@
 //
 
 #pragma once
+#include <array>
 #include <chrono>
 #include <map>
 #include <memory>
@@ -13,8 +14,10 @@
 #include <string_view>
 #include <string>
 #include <cstdint>
+#include <limits>
 #include <unordered_set>
 #include <unordered_map>
+#include <vector>
 
 //X-macro patter to make enum declaration easier to automatically generate tostrings for ui viewing
 #define STATE_LIST(X) X(pending) X(running) X(completed) X(stopped) X(cancelled)
@@ -73,6 +76,30 @@ struct SizeXYZ
     float X, Y, Z;
 };
 
+//urgency of a priority, the enum order is not the urgency order
+inline int priorityLevel(Priority priority)
+{
+    switch (priority)
+    {
+    case Priority::low:
+        return 0;
+    case Priority::normal:
+        return 1;
+    case Priority::high:
+        return 2;
+    case Priority::urgent:
+        return 3;
+    default:
+        return 1;
+    }
+}
+
+//weight of a job in the tardiness objectives, an urgent hour late costs four low ones
+inline double priorityWeight(Priority priority)
+{
+    return 1.0 + priorityLevel(priority);
+}
+
 struct Job
 {
     JobID Id;
@@ -81,7 +108,8 @@ struct Job
     Priority priority;
     std::chrono::system_clock::time_point createdTime;
     std::chrono::system_clock::time_point startedTime;
-    std::chrono::system_clock::time_point finishedTime;
+    double finishedTime = -1.0; //seconds of simulated production, -1 while the job is open
+    double dueTime = std::numeric_limits<double>::infinity(); //seconds of simulated production, infinity for none
     bool initialized = false;
     State state = State::pending;
 };
@@ -106,6 +134,8 @@ struct Operation
     uint32_t machineTime;
     MachineType requiredMachine;
     std::set<MachineSpecs> requiredMachineSpces;
+    int setupFamily = -1; //operations of the same family share fixtures and tools, -1 for none
+    int fixtureGroup = -1; //operations packed on the same table run back to back with one setup
     State state = State::pending;
     bool completed = false;
 };
@@ -120,6 +150,7 @@ struct Machine
     SizeXYZ workEnvelope;
     std::set<MachineSpecs> machineSpecs;
     MachineSizeClass sizeClass;
+    uint16_t magazineCapacity = 0; //tool slots, 0 when unknown
 };
 
 struct Tool
@@ -144,6 +175,7 @@ struct ProductionState
     std::map<MachineID, Machine> machines;
     std::map<OperationID, Operation> operations;
     int count = 0;
+    double time = 0.0; //seconds of simulated production, plans start at this time
 };
 
 struct MachineRuntime
@@ -152,10 +184,154 @@ struct MachineRuntime
     double remaining_time = 0.0;
 };
 
+//a tool predicted to run out of life during a queued operation
+struct ToolExpiry
+{
+    ToolID tool;
+    MachineID machine;
+    OperationID operation;
+    double inSeconds; //time until that operation starts
+};
+
+//completed jobs of one priority, lateness only counts jobs that have a due date
+struct PriorityKpi
+{
+    int completed = 0;
+    double totalFlowTime = 0.0;
+    int withDueDate = 0;
+    double totalLateness = 0.0;
+    double maxLateness = 0.0;
+    int late = 0;
+};
+
+//schedule quality, times are seconds of simulated production since the engine started
+struct KpiSnapshot
+{
+    double time = 0.0;
+    double makespan = 0.0; //last operation completion
+    double projectedMakespan = 0.0; //now + the largest queue of work
+    double averageUtilization = 0.0;
+    std::map<MachineID, double> utilization;
+    double averageAvailability = 1.0; //time not stopped by a failure
+    std::map<MachineID, double> availability;
+    double averageFlowTime = 0.0;
+    std::array<PriorityKpi, 4> byPriority{}; //indexed by priorityLevel
+    int completedJobs = 0;
+    int completedOperations = 0;
+    int openJobs = 0; //work in progress
+    int openParts = 0;
+    int runningOperations = 0;
+    int queuedOperations = 0;
+};
+
+//difference between two consecutive plans, only operations planned in both are compared
+struct ScheduleDiff
+{
+    int kept = 0;
+    int added = 0;
+    int removed = 0; //finished or dropped since the old plan
+    int moved = 0; //planned on another machine
+    int resequenced = 0; //same machine, another operation before it
+    double meanStartShift = 0.0; //seconds of simulated production, absolute value
+    double maxStartShift = 0.0;
+};
+
+//how much the plan churned since the engine started
+struct PlanStability
+{
+    ScheduleDiff last;
+    int replans = 0;
+    long long moved = 0;
+    long long resequenced = 0;
+};
+
+//spread of one quantity over monte carlo runs
+struct Distribution
+{
+    double mean = 0.0;
+    double stddev = 0.0;
+    double min = 0.0;
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p95 = 0.0;
+    double max = 0.0;
+};
+
+//how a plan holds up under random failures and processing time variation, times count from planTime
+struct RobustnessReport
+{
+    int runs = 0;
+    int infeasibleRuns = 0; //machine orders against the routings, left out of the distributions
+    double planTime = 0.0; //simulated time the plan was evaluated at
+    double plannedMakespan = 0.0; //without any disturbance
+    double plannedTardiness = 0.0;
+    Distribution makespan;
+    Distribution tardiness; //weighted
+    Distribution late; //parts finishing after their due date
+};
+
+//job carrying its own parts and operations so any engine can take it, the ids only link them inside the order
+struct JobOrder
+{
+    Job job; //parts keyed by ids of the order parts
+    std::vector<Part> parts; //operations listed by ids of the order operations
+    std::vector<Operation> operations;
+};
+
+//machine stopped for a while, seconds from the fork
+struct MachineOutage
+{
+    MachineID machine;
+    double start = 0.0;
+    double duration = 0.0;
+};
+
+//repeat of an existing job accepted as a new order
+struct RushOrder
+{
+    int sourceJob;
+    Priority priority = Priority::urgent;
+    double dueIn = std::numeric_limits<double>::infinity(); //seconds from the fork
+};
+
+struct WhatIfScenario
+{
+    std::string name;
+    std::vector<MachineOutage> outages;
+    std::vector<RushOrder> orders;
+};
+
+//the fork planned and run without and with the scenario, same seeds for both
+struct WhatIfResult
+{
+    int id = 0;
+    std::string name;
+    RobustnessReport baseline;
+    RobustnessReport scenario;
+    double seconds = 0.0; //wall time of the evaluation
+};
+
 struct StateSnapshot
 {
     ProductionState productionState;
     std::unordered_map<MachineID, MachineRuntime> runtime;
+    std::vector<ToolExpiry> toolExpiries;
+    int toolReplacements = 0;
+    KpiSnapshot kpis;
+    PlanStability planStability;
+    std::optional<RobustnessReport> robustness; //last finished monte carlo evaluation
+    std::vector<WhatIfResult> whatIf; //finished sandbox evaluations, latest last
+};
+
+//several engines, one per cell, seen as one plant
+struct ShardedSnapshot
+{
+    std::vector<std::shared_ptr<const StateSnapshot>> cells; //latest of each cell, shared with the router
+    KpiSnapshot kpis; //counts summed, utilization and availability averaged over the machines of every cell
+    std::vector<double> backlog; //seconds of queued work per machine of each cell, as the router estimates it
+    std::vector<int> routed; //orders sent to each cell
+    int pooledOrders = 0; //accepted and waiting for a cell with room
+    int unroutableOrders = 0; //no cell has machines for every operation, the rest of the order still runs
 };
 
 struct ToolLib
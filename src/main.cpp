@@ -1,9 +1,14 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <ostream>
 #include <SDL2/SDL.h>
 #include <SDL_opengl.h>
 
 #include "Engine.hpp"
+#include "ShardedEngine.hpp"
 #include "Gui.hpp"
 #include "imgui.h"
 #include "imgui_impl_sdl2.h"
@@ -13,14 +18,49 @@
 
 int main(int argc, char* argv[])
 {
-    Engine engine(std::chrono::milliseconds{250});
-    StateSnapshot latestState;
+    //optional --seed <n> to reproduce a previous run
+    //optional --cells <n> runs a plant of n cells, one engine each behind a router
+    std::optional<uint64_t> seed;
+    int cells = 1;
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--seed") == 0)
+        {
+            seed = std::strtoull(argv[i + 1], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--cells") == 0)
+        {
+            cells = std::max(1, std::atoi(argv[i + 1]));
+        }
+    }
 
-    GuiManager manager(engine);
+    std::unique_ptr<Engine> engine;
+    std::unique_ptr<ShardedEngine> plant;
+    std::unique_ptr<GuiManager> manager;
+    if (cells > 1)
+    {
+        plant = std::make_unique<ShardedEngine>(cells, std::chrono::milliseconds{250}, seed);
+        std::cout << "Plant seed: " << plant->getSeed() << std::endl;
+        manager = std::make_unique<GuiManager>(*plant);
+    }
+    else
+    {
+        engine = std::make_unique<Engine>(std::chrono::milliseconds{250}, seed);
+        std::cout << "Engine seed: " << engine->getSeed() << std::endl;
+        manager = std::make_unique<GuiManager>(*engine);
+    }
+    StateSnapshot latestState;
+    ShardedSnapshot latestPlant;
+    auto stopEngines = [&]()
+    {
+        if (plant) plant->stop();
+        else engine->stop();
+    };
 
 
     //initialize engine with random tools and machines using commands
-    engine.start();
+    if (plant) plant->start();
+    else engine->start();
 
 
     // Initialize SDL
@@ -96,7 +136,7 @@ int main(int argc, char* argv[])
             ImGui_ImplSDL2_ProcessEvent(&event);
             if (event.type == SDL_QUIT)
             {
-                engine.stop();
+                stopEngines();
                 done = true;
             }
 
@@ -105,13 +145,23 @@ int main(int argc, char* argv[])
                 event.window.windowID == SDL_GetWindowID(window))
             {
                 done = true;
-                engine.stop();
+                stopEngines();
             }
         }
 
-        while (auto snap = engine.pollUpdate())
+        if (plant)
         {
-            latestState = std::move(*snap);
+            while (auto update = plant->pollUpdate())
+            {
+                latestPlant = std::move(*update);
+            }
+        }
+        else
+        {
+            while (auto snap = engine->pollUpdate())
+            {
+                latestState = std::move(*snap);
+            }
         }
 
 
@@ -120,7 +170,8 @@ int main(int argc, char* argv[])
         ImGui_ImplSDL2_NewFrame();
         ImGui::NewFrame();
         ImGui::ShowDemoWindow();
-        manager.renderGui(latestState);
+        if (plant) manager->renderPlantGui(latestPlant);
+        else manager->renderGui(latestState);
 
 
         // Rendering
@@ -131,7 +182,7 @@ int main(int argc, char* argv[])
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
         SDL_GL_SwapWindow(window);
     }
-    engine.stop();
+    stopEngines();
     // Cleanup
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplSDL2_Shutdown();
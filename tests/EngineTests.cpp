@@ -0,0 +1,1223 @@
+//
+// Regression tests of the generators, the schedulers and the engine, the engine ones drive it through the
+// command api like the gui does
+//
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "Engine.hpp"
+#include "ExactSolver.hpp"
+#include "GeneticScheduler.hpp"
+#include "MonteCarlo.hpp"
+#include "Reliability.hpp"
+#include "RollingHorizon.hpp"
+#include "ScheduleEvaluator.hpp"
+#include "ShardedEngine.hpp"
+#include "WhatIf.hpp"
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool condition, const std::string& what)
+    {
+        if (condition) return;
+        ++failures;
+        std::cerr << "FAILED: " << what << std::endl;
+    }
+
+    // the clock is stopped so the shop only moves on fast forwards, every tick publishes a snapshot
+    struct TestShop
+    {
+        Engine engine{std::chrono::milliseconds(20), 42};
+
+        TestShop(int tools, int machines, int jobs)
+        {
+            engine.start();
+            send(SetTimeScaleCommand{0.0}, [](const StateSnapshot&) { return true; });
+            send(GenerateRandomToolsCommand{tools},
+                 [](const StateSnapshot& s) { return !s.productionState.tools.empty(); });
+            send(GenerateRandomMachinesCommand{machines},
+                 [](const StateSnapshot& s) { return !s.productionState.machines.empty(); });
+            if (jobs > 0)
+            {
+                send(GenerateRandomJobsCommand{jobs, jobs},
+                     [](const StateSnapshot& s) { return !s.productionState.jobs.empty(); });
+            }
+        }
+
+        ~TestShop()
+        {
+            engine.stop();
+        }
+
+        // first snapshot published after the command that satisfies done
+        StateSnapshot send(const CommandVariant& command, const std::function<bool(const StateSnapshot&)>& done)
+        {
+            while (engine.pollUpdate()) {}
+            engine.sendCommand(command);
+            while (true)
+            {
+                auto snapshot = engine.pollUpdate();
+                if (!snapshot) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                else if (done(*snapshot)) return std::move(*snapshot);
+            }
+        }
+
+        // fast forwards in steps and hands the snapshot after every step to visit
+        StateSnapshot run(double seconds, double step, const std::function<void(const StateSnapshot&)>& visit)
+        {
+            StateSnapshot snapshot = send(ResetKpisCommand{}, [](const StateSnapshot&) { return true; });
+            for (double t = 0.0; t < seconds; t += step)
+            {
+                const double target = snapshot.productionState.time + step - 1e-6;
+                snapshot = send(FastForwardCommand{step},
+                                [target](const StateSnapshot& s) { return s.productionState.time >= target; });
+                visit(snapshot);
+            }
+            return snapshot;
+        }
+    };
+
+    // one part with one operation per entry of ops, in routing order
+    JobOrder singlePartOrder(const std::vector<Operation>& ops)
+    {
+        JobOrder order;
+        order.job.jobId = 1;
+        order.job.priority = Priority::normal;
+        order.job.parts[1] = 1;
+        Part part{};
+        part.id = 1;
+        part.partSize = SizeXYZ{10.0f, 10.0f, 10.0f};
+        for (size_t k = 0; k < ops.size(); ++k)
+        {
+            Operation op = ops[k];
+            op.id = static_cast<OperationID>(k + 1);
+            op.partId = part.id;
+            op.totalTime = op.setupTime + op.machineTime * op.quantity;
+            part.operations.push_back(op.id);
+            order.operations.push_back(op);
+        }
+        order.parts.push_back(part);
+        return order;
+    }
+
+    // one single operation part per entry of ops
+    JobOrder onePartEach(Priority priority, const std::vector<Operation>& ops)
+    {
+        JobOrder order;
+        order.job.jobId = 1;
+        order.job.priority = priority;
+        for (size_t k = 0; k < ops.size(); ++k)
+        {
+            Part part{};
+            part.id = static_cast<PartID>(k + 1);
+            part.partSize = SizeXYZ{10.0f, 10.0f, 10.0f};
+            Operation op = ops[k];
+            op.id = static_cast<OperationID>(k + 1);
+            op.partId = part.id;
+            op.totalTime = op.setupTime + op.machineTime * op.quantity;
+            part.operations.push_back(op.id);
+            order.job.parts[part.id] = 1;
+            order.operations.push_back(op);
+            order.parts.push_back(part);
+        }
+        return order;
+    }
+
+    bool close(double a, double b)
+    {
+        if (std::isinf(a) || std::isinf(b)) return a == b;
+        return std::abs(a - b) <= 1e-9 * std::max(1.0, std::abs(a));
+    }
+
+    std::map<MachineID, Machine> randomMachines(std::mt19937& rng, int count)
+    {
+        std::map<MachineID, Machine> machines;
+        for (MachineID id = 0; id < count; ++id)
+        {
+            Machine& m = machines[id];
+            m.id = id;
+            m.status = MachineState::idle;
+            m.machineType = randomMachineType(rng);
+            m.sizeClass = randomMachineSizeClass(rng);
+            m.workEnvelope = randomWorkEnvelope(rng, m.sizeClass);
+            m.machineSpecs = randomMachineSpecs(rng);
+        }
+        return machines;
+    }
+
+    bool sameOperation(const Operation& a, const Operation& b)
+    {
+        return a.id == b.id && a.partId == b.partId && a.quantity == b.quantity && a.tools == b.tools &&
+            a.setupTime == b.setupTime && a.machineTime == b.machineTime && a.requiredMachine == b.requiredMachine &&
+            a.requiredMachineSpces == b.requiredMachineSpces;
+    }
+
+    // identical idle machines with room for any part, the optimizer tests add their parts with addPart
+    ProductionState handShop(int machines)
+    {
+        ProductionState state;
+        for (MachineID id = 0; id < machines; ++id)
+        {
+            Machine& m = state.machines[id];
+            m.id = id;
+            m.status = MachineState::idle;
+            m.machineType = MachineType::VMC_3AXIS;
+            m.sizeClass = MachineSizeClass::Large;
+            m.workEnvelope = SizeXYZ{1000.0f, 1000.0f, 1000.0f};
+        }
+        return state;
+    }
+
+    // new job of one part with an operation per entry of seconds in routing order, the job shares the part id
+    std::vector<OperationID> addPart(ProductionState& state, const std::vector<uint32_t>& seconds)
+    {
+        const PartID pid = state.parts.empty() ? 1 : state.parts.rbegin()->first + 1;
+        Part& part = state.parts[pid];
+        part.id = pid;
+        part.partSize = SizeXYZ{10.0f, 10.0f, 10.0f};
+        for (uint32_t s : seconds)
+        {
+            Operation op{};
+            op.id = state.operations.empty() ? 1 : state.operations.rbegin()->first + 1;
+            op.partId = pid;
+            op.quantity = 1;
+            op.machineTime = s;
+            op.totalTime = s;
+            op.requiredMachine = MachineType::VMC_3AXIS;
+            part.operations.push_back(op.id);
+            state.operations[op.id] = op;
+        }
+        Job job{};
+        job.jobId = pid;
+        job.priority = Priority::normal;
+        job.parts[pid] = 1;
+        state.jobs[pid] = job;
+        return part.operations;
+    }
+
+    // parts of one to three operations of 10 to 100 s with up to 30 s of setup
+    void addRandomParts(ProductionState& state, std::mt19937& rng, int count)
+    {
+        std::uniform_int_distribution<int> length(1, 3);
+        std::uniform_int_distribution<uint32_t> cut(10, 100);
+        std::uniform_int_distribution<uint32_t> setup(0, 30);
+        for (int k = 0; k < count; ++k)
+        {
+            std::vector<uint32_t> seconds(length(rng));
+            for (auto& s : seconds) s = cut(rng);
+            for (OperationID opid : addPart(state, seconds)) state.operations[opid].setupTime = setup(rng);
+        }
+    }
+
+    std::vector<OptiProSimple::ScheduledOp> listPlan(const ProductionState& state,
+                                                     const OptiProSimple::ScheduleOptions& options = {})
+    {
+        OptiProSimple::Graph g;
+        OptiProSimple::build_graph_from_state(state, g);
+        auto machines = OptiProSimple::build_opt_machines(state);
+        return OptiProSimple::schedule_orders(g, machines, state, 0.0, {}, options);
+    }
+
+    double makespan(const std::vector<OptiProSimple::ScheduledOp>& schedule)
+    {
+        double end = 0.0;
+        for (const auto& s : schedule) end = std::max(end, s.end);
+        return end;
+    }
+
+    // operations planned other than once, run before the one ahead of them in the routing or overlapping on a machine
+    int planErrors(const ProductionState& state, const std::vector<OptiProSimple::ScheduledOp>& schedule)
+    {
+        int errors = 0;
+        std::map<OperationID, const OptiProSimple::ScheduledOp*> planned;
+        for (const auto& s : schedule) errors += !planned.emplace(s.op_id, &s).second;
+        errors += static_cast<int>(state.operations.size()) - static_cast<int>(planned.size());
+        for (const auto& [pid, part] : state.parts)
+        {
+            for (size_t k = 1; k < part.operations.size(); ++k)
+            {
+                auto before = planned.find(part.operations[k - 1]);
+                auto after = planned.find(part.operations[k]);
+                if (before == planned.end() || after == planned.end()) continue;
+                errors += after->second->start < before->second->end - 1e-6;
+            }
+        }
+        std::map<MachineID, std::vector<std::pair<double, double>>> busy;
+        for (const auto& s : schedule) busy[s.machine_id].emplace_back(s.start, s.end);
+        for (auto& [mid, runs] : busy)
+        {
+            std::sort(runs.begin(), runs.end());
+            for (size_t k = 1; k < runs.size(); ++k) errors += runs[k].first < runs[k - 1].second - 1e-6;
+        }
+        return errors;
+    }
+
+    struct GeneratedShop
+    {
+        std::map<ToolID, Tool> tools;
+        std::map<MachineID, Machine> machines;
+        std::map<PartID, Part> parts;
+        std::map<OperationID, Operation> operations;
+    };
+
+    GeneratedShop generateShop(uint64_t seed)
+    {
+        RngStreams rng(seed);
+        GeneratedShop shop;
+        shop.tools = generateToolLibrary(rng.tools, 30, 1).first.tools;
+        shop.machines = randomMachines(rng.machines, 12);
+        auto [parts, operations, nextPart, nextOp] = generateRandomParts(rng.parts, 50, 1, 1, shop.tools,
+                                                                         shop.machines);
+        shop.parts = std::move(parts);
+        shop.operations = std::move(operations);
+        return shop;
+    }
+
+    bool sameShop(const GeneratedShop& a, const GeneratedShop& b)
+    {
+        if (a.tools.size() != b.tools.size() || a.machines.size() != b.machines.size() ||
+            a.parts.size() != b.parts.size() || a.operations.size() != b.operations.size()) return false;
+        for (const auto& [id, tool] : a.tools)
+        {
+            const auto& other = b.tools.at(id);
+            if (tool.maxToolLife != other.maxToolLife || tool.compatibleMachines != other.compatibleMachines)
+                return false;
+        }
+        for (const auto& [id, m] : a.machines)
+        {
+            const auto& other = b.machines.at(id);
+            if (m.machineType != other.machineType || m.sizeClass != other.sizeClass ||
+                m.workEnvelope.X != other.workEnvelope.X || m.workEnvelope.Y != other.workEnvelope.Y ||
+                m.workEnvelope.Z != other.workEnvelope.Z || m.machineSpecs != other.machineSpecs) return false;
+        }
+        for (const auto& [id, part] : a.parts)
+        {
+            const auto& other = b.parts.at(id);
+            if (part.operations != other.operations || part.partSize.X != other.partSize.X ||
+                part.partSize.Y != other.partSize.Y || part.partSize.Z != other.partSize.Z) return false;
+        }
+        for (const auto& [id, op] : a.operations)
+        {
+            if (!sameOperation(op, b.operations.at(id))) return false;
+        }
+        return true;
+    }
+
+    // a seed generates the same shop every time and drawing from one stream leaves the others alone
+    void seededGenerationRepeats()
+    {
+        check(sameShop(generateShop(11), generateShop(11)), "seeded generation: the same seed gives the same shop");
+        check(!sameShop(generateShop(11), generateShop(12)), "seeded generation: another seed gives another shop");
+
+        RngStreams quiet(11);
+        RngStreams busy(11);
+        busy.machines.discard(1000);
+        busy.tools.discard(77);
+        bool same = true;
+        for (int k = 0; k < 100; ++k) same = same && quiet.jobs() == busy.jobs() && quiet.failures() == busy.failures();
+        check(same, "seeded generation: machines and tools draws dont shift the jobs and failures streams");
+    }
+
+    // the bulk generator gives the same jobs on any number of threads, with dense ids linking jobs, parts and
+    // operations across its chunks
+    void bulkGenerationIgnoresThreads()
+    {
+        const auto shop = generateShop(5);
+        const auto pools = buildGeneratorPools({}, shop.machines, shop.tools);
+        const int jobs = 2 * kBulkJobsPerChunk + 17;
+        const auto one = generateRandomJobsBulk(5, jobs, 1, 1, 1, pools, 1);
+        const auto four = generateRandomJobsBulk(5, jobs, 1, 1, 1, pools, 4);
+
+        bool same = one.jobs.size() == four.jobs.size() && one.parts.size() == four.parts.size() &&
+            one.operations.size() == four.operations.size();
+        for (size_t k = 0; same && k < one.jobs.size(); ++k)
+        {
+            same = one.jobs[k].jobId == four.jobs[k].jobId && one.jobs[k].parts == four.jobs[k].parts &&
+                one.jobs[k].priority == four.jobs[k].priority;
+        }
+        for (size_t k = 0; same && k < one.parts.size(); ++k)
+        {
+            same = one.parts[k].id == four.parts[k].id && one.parts[k].operations == four.parts[k].operations;
+        }
+        for (size_t k = 0; same && k < one.operations.size(); ++k)
+        {
+            same = sameOperation(one.operations[k], four.operations[k]);
+        }
+        check(same, "bulk generation: one and four threads give the same jobs");
+
+        bool linked = static_cast<int>(one.jobs.size()) == jobs;
+        for (size_t k = 0; k < one.jobs.size(); ++k)
+        {
+            linked = linked && one.jobs[k].jobId == static_cast<int>(k) + 1;
+            for (const auto& [pid, qty] : one.jobs[k].parts)
+            {
+                linked = linked && pid >= 1 && pid <= static_cast<int>(one.parts.size());
+            }
+        }
+        for (size_t k = 0; k < one.parts.size(); ++k)
+        {
+            linked = linked && one.parts[k].id == static_cast<int>(k) + 1;
+            for (OperationID opid : one.parts[k].operations)
+            {
+                linked = linked && opid >= 1 && opid <= static_cast<int>(one.operations.size()) &&
+                    one.operations[opid - 1].partId == one.parts[k].id;
+            }
+        }
+        for (size_t k = 0; k < one.operations.size(); ++k)
+        {
+            linked = linked && one.operations[k].id == static_cast<int>(k) + 1;
+        }
+        check(linked, "bulk generation: jobs, parts and operations are numbered densely and point at each other");
+    }
+
+    // the tools the generator picks for an operation are ones its machine type takes
+    void operationToolsFitTheirMachine()
+    {
+        const auto shop = generateShop(3);
+        int tooled = 0;
+        int misfits = 0;
+        for (const auto& [opid, op] : shop.operations)
+        {
+            tooled += !op.tools.empty();
+            for (ToolID t : op.tools) misfits += !shop.tools.at(t).compatibleMachines.count(op.requiredMachine);
+        }
+        check(tooled > 0, "operation tools: operations get tools");
+        check(misfits == 0, "operation tools: " + std::to_string(misfits) + " tools dont fit the machine type");
+    }
+
+    // no operation runs or finishes before the one ahead of it in the part routing is done
+    void routingPrecedenceHolds()
+    {
+        TestShop shop(40, 30, 40);
+        int arcs = 0;
+        int violations = 0;
+        int completedJobs = 0;
+        shop.run(100000.0, 500.0, [&](const StateSnapshot& snapshot)
+        {
+            const auto& state = snapshot.productionState;
+            arcs = 0;
+            for (const auto& [partId, part] : state.parts)
+            {
+                for (size_t k = 1; k < part.operations.size(); ++k)
+                {
+                    ++arcs;
+                    const auto& before = state.operations.at(part.operations[k - 1]);
+                    const auto& after = state.operations.at(part.operations[k]);
+                    const bool started = after.completed || after.state == State::running;
+                    if (started && !before.completed) ++violations;
+                }
+            }
+            completedJobs = snapshot.kpis.completedJobs;
+        });
+        check(arcs > 0, "routing precedence: the shop has multi-operation routings");
+        check(violations == 0, "routing precedence: " + std::to_string(violations) + " arcs run out of order");
+        check(completedJobs > 0, "routing precedence: jobs complete");
+    }
+
+    // one machine taking one tool at a time, batching the alternating setups pays fewer of them
+    void setupBatchingSavesSetups()
+    {
+        ProductionState state = handShop(1);
+        state.machines[0].magazineCapacity = 1;
+        for (int k = 0; k < 8; ++k)
+        {
+            auto& op = state.operations[addPart(state, {10}).front()];
+            op.setupTime = 100;
+            op.tools = {k % 2 + 1};
+        }
+        auto switches = [&state](const std::vector<OptiProSimple::ScheduledOp>& schedule)
+        {
+            auto ordered = schedule;
+            std::sort(ordered.begin(), ordered.end(),
+                      [](const auto& a, const auto& b) { return a.start < b.start; });
+            int count = 0;
+            for (size_t k = 1; k < ordered.size(); ++k)
+            {
+                count += OptiProSimple::setup_signature(state.operations.at(ordered[k].op_id)) !=
+                    OptiProSimple::setup_signature(state.operations.at(ordered[k - 1].op_id));
+            }
+            return count;
+        };
+        OptiProSimple::ScheduleOptions options;
+        const auto plain = listPlan(state, options);
+        options.batch_setups = true;
+        const auto batched = listPlan(state, options);
+        check(planErrors(state, batched) == 0, "setup batching: the batched plan is valid");
+        check(switches(batched) < switches(plain), "setup batching: fewer setup changes");
+        check(makespan(batched) < makespan(plain), "setup batching: the backlog finishes earlier");
+    }
+
+    // a magazine too small for the tool set rules the machine out, among the rest the one with the tools
+    // already loaded wins on its residual setup
+    void magazineAwareDispatch()
+    {
+        ProductionState state = handShop(2);
+        auto& op = state.operations[addPart(state, {50}).front()];
+        op.setupTime = 100;
+        op.tools = {1, 2};
+        state.machines[0].magazineCapacity = 1;
+        check(!OptiProSimple::machine_can_run(state.machines[0], op), "magazine: two tools dont fit one slot");
+        check(OptiProSimple::machine_can_run(state.machines[1], op), "magazine: an unknown magazine takes them");
+
+        state.machines[0].magazineCapacity = 0;
+        state.machines[1].tools = {{0, 1}, {1, 2}};
+        const auto plan = listPlan(state);
+        check(plan.size() == 1 && plan.front().machine_id == 1, "magazine: the machine carrying the tools runs it");
+        check(plan.size() == 1 && close(plan.front().end, 0.1 * 100 + 50), "magazine: only the residual setup is paid");
+    }
+
+    // a batch cutting longer than a fresh tool lasts gets the tool swapped on the way instead of wearing past zero
+    void toolSwappedMidOperation()
+    {
+        TestShop shop(10, 3, 0);
+        const auto machines = shop.send(SetTimeScaleCommand{0.0}, [](const StateSnapshot&) { return true; });
+        const Machine& machine = machines.productionState.machines.begin()->second;
+        Tool tool{};
+        tool.toolId = 1;
+        tool.compatibleMachines = {machine.machineType};
+        tool.maxToolLife = 100;
+        tool.currentToolLife = 100;
+        shop.send(SetToolLibraryCommand{{{1, tool}}},
+                  [](const StateSnapshot& s) { return s.productionState.tools.size() == 1; });
+
+        Operation op{};
+        op.quantity = 5;
+        op.machineTime = 60; // 300 s of cutting, three lives of the tool
+        op.setupTime = 10;
+        op.tools = {1};
+        op.requiredMachine = machine.machineType;
+        shop.send(AddOrderCommand{singlePartOrder({op})},
+                  [](const StateSnapshot& s) { return !s.productionState.operations.empty(); });
+        const auto done = shop.run(2000.0, 100.0, [](const StateSnapshot&) {});
+
+        const auto& ran = done.productionState.operations.begin()->second;
+        check(ran.completed, "tool swap: the operation completes");
+        // one swap before it starts, the worn tool can't cut it, and two while it cuts
+        check(done.toolReplacements == 3,
+              "tool swap: " + std::to_string(done.toolReplacements) + " replacements instead of 3");
+        check(ran.machineTime == 60, "tool swap: the cycle time is left as generated");
+    }
+
+    // parts packed onto one table from jobs of different priority still run back to back, an urgent operation
+    // of another setup doesnt get in between them
+    void packedTableRunsBackToBack()
+    {
+        TestShop shop(10, 1, 0);
+        const auto first = shop.send(SetTimeScaleCommand{0.0}, [](const StateSnapshot&) { return true; });
+        const Machine& machine = first.productionState.machines.begin()->second;
+        std::map<ToolID, Tool> tools;
+        for (ToolID id : {1, 2})
+        {
+            Tool tool{};
+            tool.toolId = id;
+            tool.compatibleMachines = {machine.machineType};
+            tool.maxToolLife = 10000;
+            tool.currentToolLife = 10000;
+            tools[id] = tool;
+        }
+        shop.send(SetToolLibraryCommand{tools},
+                  [](const StateSnapshot& s) { return s.productionState.tools.size() == 2; });
+        OptiProSimple::ScheduleOptions options;
+        options.pack_fixtures = true;
+        options.background_reoptimize = false; // the queues stay as the insertion left them
+        shop.send(SetScheduleOptionsCommand{options}, [](const StateSnapshot&) { return true; });
+
+        auto cut = [&](ToolID tool)
+        {
+            Operation op{};
+            op.quantity = 1;
+            op.machineTime = 100;
+            op.setupTime = 10;
+            op.tools = {tool};
+            op.requiredMachine = machine.machineType;
+            return op;
+        };
+        shop.send(AddOrderCommand{onePartEach(Priority::low, {cut(1)})},
+                  [](const StateSnapshot& s) { return s.productionState.operations.size() == 1; });
+        shop.send(AddOrderCommand{onePartEach(Priority::urgent, {cut(1), cut(2)})},
+                  [](const StateSnapshot& s) { return s.productionState.operations.size() == 3; });
+
+        std::vector<OperationID> started;
+        std::map<OperationID, int> table;
+        const auto done = shop.run(1000.0, 20.0, [&](const StateSnapshot& snapshot)
+        {
+            for (const auto& [mid, runtime] : snapshot.runtime)
+            {
+                if (!runtime.current_op || (!started.empty() && started.back() == *runtime.current_op)) continue;
+                started.push_back(*runtime.current_op);
+            }
+            for (const auto& [opid, op] : snapshot.productionState.operations)
+            {
+                if (op.fixtureGroup >= 0) table[opid] = op.fixtureGroup;
+            }
+        });
+        check(done.productionState.operations.size() == 3 && started.size() == 3,
+              "packed table: the three operations run");
+        check(table.size() == 2, "packed table: the two parts cut with the same tool share a table");
+        bool together = started.size() == 3 && table.count(started[1]) &&
+            (table.count(started[0]) || table.count(started[2]));
+        check(together, "packed table: the members run back to back");
+    }
+
+    // the eligibility index finds exactly the machines a scan with machine_can_run finds
+    void partSizeEligibility()
+    {
+        using OptiProSimple::part_fits_envelope;
+        const SizeXYZ table{120.0f, 400.0f, 60.0f};
+        check(part_fits_envelope({300.0f, 100.0f, 50.0f}, table), "eligibility: a part turned on the table fits");
+        check(!part_fits_envelope({300.0f, 100.0f, 70.0f}, table), "eligibility: a part too tall doesnt fit");
+        check(!part_fits_envelope({450.0f, 100.0f, 50.0f}, table), "eligibility: a part too long doesnt fit");
+
+        std::mt19937 rng(17);
+        auto machines = randomMachines(rng, 60);
+        std::uniform_int_distribution<int> slots(0, 4);
+        for (auto& [mid, m] : machines) m.magazineCapacity = static_cast<uint16_t>(slots(rng));
+        const OptiProSimple::EligibilityIndex index(machines);
+        std::uniform_real_distribution<float> side(10.0f, 1500.0f);
+        int queries = 0;
+        int found = 0;
+        int mismatches = 0;
+        for (int k = 0; k < 500; ++k)
+        {
+            Operation op{};
+            op.requiredMachine = randomMachineType(rng);
+            if (k % 3 == 0) op.requiredMachineSpces = randomMachineSpecs(rng);
+            for (int t = slots(rng); t > 0; --t) op.tools.insert(t);
+            const SizeXYZ size{side(rng), side(rng), side(rng) / 2};
+            for (const SizeXYZ* part : {&size, static_cast<const SizeXYZ*>(nullptr)})
+            {
+                std::set<MachineID> expected;
+                for (const auto& [mid, m] : machines)
+                {
+                    if (part ? OptiProSimple::machine_can_run(m, op, *part) : OptiProSimple::machine_can_run(m, op))
+                        expected.insert(mid);
+                }
+                std::set<MachineID> got;
+                index.for_each_eligible(op, part, [&got](const Machine& m) { got.insert(m.id); });
+                ++queries;
+                found += !expected.empty();
+                mismatches += got != expected;
+            }
+        }
+        check(found > 0 && found < queries, "eligibility: queries with and without eligible machines");
+        check(mismatches == 0, "eligibility: " + std::to_string(mismatches) + " queries differ from a full scan");
+    }
+
+    // the balancer picks what a scan picks, the lowest load plus penalty among accepted compatible machines
+    void leastLoadedPick()
+    {
+        std::mt19937 rng(23);
+        std::map<MachineID, Machine> machines;
+        for (MachineID id = 0; id < 24; ++id)
+        {
+            Machine& m = machines[id];
+            m.id = id;
+            m.machineType = id % 2 ? MachineType::LATHE : MachineType::VMC_3AXIS;
+            if (id % 3 == 0) m.machineSpecs = {MachineSpecs::long_tools};
+        }
+        LoadBalancer balancer;
+        balancer.build(machines);
+        std::uniform_int_distribution<MachineID> anyMachine(0, 23);
+        std::uniform_int_distribution<int> seconds(0, 400);
+        int picked = 0;
+        int mismatches = 0;
+        for (int k = 0; k < 2000; ++k)
+        {
+            // round loads so ties happen
+            if (k % 2) balancer.add(anyMachine(rng), 10.0 * (seconds(rng) / 10));
+            else balancer.set(anyMachine(rng), 10.0 * (seconds(rng) / 10));
+
+            Operation op{};
+            op.requiredMachine = k % 2 ? MachineType::LATHE : MachineType::VMC_3AXIS;
+            if (k % 5 == 0) op.requiredMachineSpces = {MachineSpecs::long_tools};
+            const int refused = k % 7;
+            auto accept = [refused](MachineID mid) { return mid % 7 != refused; };
+            auto penalty = [](MachineID mid) { return 5.0 * (mid % 4); };
+            MachineID expected = -1;
+            double best = 0.0;
+            for (const auto& [mid, m] : machines)
+            {
+                if (!OptiProSimple::machine_can_run(m, op) || !accept(mid)) continue;
+                const double score = balancer.load(mid) + penalty(mid);
+                if (expected < 0 || score < best)
+                {
+                    expected = mid;
+                    best = score;
+                }
+            }
+            const MachineID got = balancer.pick(op, accept, penalty);
+            picked += got >= 0;
+            mismatches += got != expected;
+        }
+        check(picked > 0, "least loaded: machines are picked");
+        check(mismatches == 0, "least loaded: " + std::to_string(mismatches) + " picks differ from a full scan");
+    }
+
+    // a job is completed exactly when every one of its parts is, and a part when all its operations are
+    void jobCompletionFollowsParts()
+    {
+        TestShop shop(40, 30, 40);
+        int completedJobs = 0;
+        int mismatches = 0;
+        shop.run(100000.0, 500.0, [&](const StateSnapshot& snapshot)
+        {
+            const auto& state = snapshot.productionState;
+            completedJobs = 0;
+            for (const auto& [pid, part] : state.parts)
+            {
+                bool done = !part.operations.empty();
+                for (OperationID opid : part.operations) done = done && state.operations.at(opid).completed;
+                mismatches += done != (part.state == State::completed);
+            }
+            for (const auto& [jobId, job] : state.jobs)
+            {
+                bool done = true;
+                for (const auto& [pid, qty] : job.parts) done = done && state.parts.at(pid).state == State::completed;
+                mismatches += done != (job.state == State::completed);
+                completedJobs += job.state == State::completed;
+            }
+        });
+        check(completedJobs > 0, "job completion: jobs complete");
+        check(mismatches == 0, "job completion: " + std::to_string(mismatches) + " parts or jobs marked wrongly");
+    }
+
+    // without the background replan new jobs are inserted around the queued work, which keeps its machine and order
+    void insertionKeepsQueueOrder()
+    {
+        TestShop shop(40, 12, 0);
+        OptiProSimple::ScheduleOptions options;
+        options.background_reoptimize = false;
+        shop.send(SetScheduleOptionsCommand{options}, [](const StateSnapshot&) { return true; });
+        // new jobs are inserted on the next simulation step, one short enough that nothing finishes
+        auto arrive = [&shop](int queued)
+        {
+            shop.send(GenerateRandomJobsCommand{20, 20}, [](const StateSnapshot&) { return true; });
+            return shop.send(FastForwardCommand{1e-3},
+                             [queued](const StateSnapshot& s) { return s.kpis.queuedOperations > queued; });
+        };
+        const auto before = arrive(0);
+        const auto after = arrive(before.kpis.queuedOperations);
+
+        std::unordered_set<OperationID> started;
+        for (const auto& [mid, runtime] : after.runtime)
+        {
+            if (runtime.current_op) started.insert(*runtime.current_op);
+        }
+        // queued operations per machine, the ones started since before left out
+        auto queues = [&started, &before](const StateSnapshot& snapshot)
+        {
+            std::map<MachineID, std::vector<OperationID>> out;
+            for (const auto& [mid, m] : snapshot.productionState.machines)
+            {
+                for (auto q = m.operations; !q.empty(); q.pop())
+                {
+                    const OperationID opid = q.front();
+                    if (!started.count(opid) && before.productionState.operations.count(opid))
+                        out[mid].push_back(opid);
+                }
+            }
+            return out;
+        };
+        const auto kept = queues(after);
+        check(!kept.empty() && kept == queues(before),
+              "incremental insertion: the queued operations keep their machine and order");
+    }
+
+    // every operation is planned once, the window holds no more than asked and the estimated tail doesnt overlap it
+    void rollingHorizonCoversBacklog()
+    {
+        std::mt19937 rng(29);
+        ProductionState state = handShop(3);
+        addRandomParts(state, rng, 40);
+        std::vector<OperationID> order;
+        for (const auto& [pid, part] : state.parts)
+        {
+            order.insert(order.end(), part.operations.begin(), part.operations.end());
+        }
+        OptiProSimple::HorizonOptions horizon;
+        horizon.window_operations = 10;
+        const auto plan = OptiProSimple::rolling_horizon_schedule(state, order, {}, horizon);
+        check(plan.window_size > 0 && plan.window_size <= 10, "rolling horizon: the window is bounded");
+        const int errors = planErrors(state, plan.schedule);
+        check(errors == 0, "rolling horizon: " + std::to_string(errors) + " errors in the plan");
+    }
+
+    // two long and three short operations on two machines, the list schedule pairs them up badly
+    void exactBeatsList()
+    {
+        ProductionState state = handShop(2);
+        for (uint32_t seconds : {3, 3, 2, 2, 2}) addPart(state, {seconds});
+        OptiProSimple::Graph g;
+        OptiProSimple::build_graph_from_state(state, g);
+        const auto machines = OptiProSimple::build_opt_machines(state);
+        const auto exact = OptiProSimple::solve_exact(g, machines, state);
+        const auto list = listPlan(state);
+        check(exact.proven_optimal && close(exact.makespan, 6.0), "exact solver: proves the makespan of 6");
+        check(close(makespan(list), 7.0), "exact solver: the list schedule takes 7");
+
+        OptiProSimple::BackendOptions backend;
+        backend.backend = OptiProSimple::OptimizerBackend::exact;
+        auto planned = machines;
+        const auto plan = OptiProSimple::plan_schedule(g, planned, state, 0.0, {}, {}, backend);
+        check(planErrors(state, plan) == 0 && close(makespan(plan), 6.0), "exact solver: the exact backend plans it");
+    }
+
+    // the search never ends worse than the list schedule it starts from and its result doesnt depend on the threads
+    void geneticNoWorse()
+    {
+        std::mt19937 rng(31);
+        ProductionState state = handShop(3);
+        addRandomParts(state, rng, 15);
+        OptiProSimple::Graph g;
+        OptiProSimple::build_graph_from_state(state, g);
+        const auto machines = OptiProSimple::build_opt_machines(state);
+        OptiProSimple::GeneticOptions genetic;
+        genetic.time_limit_seconds = 0.0;
+        genetic.max_generations = 40;
+        genetic.seed = 3;
+        genetic.threads = 1;
+        const auto one = OptiProSimple::solve_genetic(g, machines, state, 0.0, {}, {}, genetic);
+        genetic.threads = 4;
+        const auto four = OptiProSimple::solve_genetic(g, machines, state, 0.0, {}, {}, genetic);
+        check(one.objective <= one.initial_objective, "genetic: no worse than the list schedule");
+        check(planErrors(state, one.schedule) == 0, "genetic: the plan is valid");
+        bool same = one.objective == four.objective && one.schedule.size() == four.schedule.size();
+        for (size_t k = 0; same && k < one.schedule.size(); ++k)
+        {
+            same = one.schedule[k].op_id == four.schedule[k].op_id &&
+                one.schedule[k].machine_id == four.schedule[k].machine_id;
+        }
+        check(same, "genetic: one and four threads find the same plan");
+    }
+
+    // every lane of the batched evaluator agrees with the one candidate evaluator, shuffled machine orders
+    // include ones against the routings so some lanes have cycles
+    void batchedEvaluationMatches()
+    {
+        constexpr int lanes = 8;
+        std::mt19937_64 rng(7);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        OptiProSimple::EvalProblem problem;
+        problem.operations = 60;
+        problem.machines = 5;
+        for (int o = 0; o < problem.operations; ++o)
+        {
+            problem.duration.push_back(10.0 + 90.0 * unit(rng));
+            problem.release.push_back(o % 3 == 0 ? 200.0 * unit(rng) : 0.0);
+            problem.due.push_back(o % 3 == 2 ? 400.0 + 800.0 * unit(rng) : std::numeric_limits<double>::infinity());
+            problem.weight.push_back(1.0 + unit(rng));
+            problem.job_pred.push_back(o % 3 == 0 ? -1 : o - 1); // parts of three operations
+        }
+
+        OptiProSimple::EvalBatch<lanes> batch;
+        batch.reserve(problem);
+        OptiProSimple::EvalWorkspace ws;
+        ws.reserve(problem);
+        int compared = 0;
+        int cyclic = 0;
+        int mismatches = 0;
+        for (int round = 0; round < 16; ++round)
+        {
+            std::vector<OptiProSimple::EvalProblem> single(lanes, problem);
+            std::vector<OptiProSimple::MachineSequence> sequences(lanes);
+            for (int l = 0; l < lanes; ++l)
+            {
+                std::vector<std::vector<int>> orders(problem.machines);
+                for (int o = 0; o < problem.operations; ++o) orders[rng() % problem.machines].push_back(o);
+                auto& sequence = sequences[l];
+                sequence.offsets.assign(1, 0);
+                for (auto& order : orders)
+                {
+                    // half the rounds keep the numbering, which follows the routings
+                    if (round % 2) std::shuffle(order.begin(), order.end(), rng);
+                    sequence.ops.insert(sequence.ops.end(), order.begin(), order.end());
+                    sequence.offsets.push_back(static_cast<int>(sequence.ops.size()));
+                }
+                batch.load(l, problem, sequence);
+                for (int o = 0; o < problem.operations; ++o)
+                {
+                    single[l].duration[o] = problem.duration[o] * (0.5 + unit(rng));
+                    batch.duration[static_cast<size_t>(o) * lanes + l] = single[l].duration[o];
+                }
+            }
+            OptiProSimple::evaluate_batch(problem, batch);
+            for (int l = 0; l < lanes; ++l)
+            {
+                const auto expected = OptiProSimple::evaluate_sequence(single[l], sequences[l], ws);
+                const auto& got = batch.results[l];
+                ++compared;
+                cyclic += !expected.feasible;
+                const bool same = got.feasible == expected.feasible && close(got.makespan, expected.makespan) &&
+                    (!expected.feasible || (close(got.total_tardiness, expected.total_tardiness) &&
+                                            got.late == expected.late &&
+                                            close(got.utilization, expected.utilization)));
+                mismatches += !same;
+            }
+        }
+        check(cyclic > 0 && cyclic < compared, "batched evaluation: both feasible and cyclic candidates drawn");
+        check(mismatches == 0, "batched evaluation: " + std::to_string(mismatches) + " of " +
+                               std::to_string(compared) + " lanes differ from evaluate_sequence");
+    }
+
+    // the counters kept from the engine events agree with a count over the snapshot
+    void kpisMatchSnapshot()
+    {
+        TestShop shop(40, 30, 40);
+        int mismatches = 0;
+        int steps = 0;
+        shop.run(20000.0, 500.0, [&](const StateSnapshot& snapshot)
+        {
+            const auto& state = snapshot.productionState;
+            const auto& k = snapshot.kpis;
+            int running = 0;
+            for (const auto& [mid, runtime] : snapshot.runtime) running += runtime.current_op.has_value();
+            int queued = 0;
+            for (const auto& [mid, m] : state.machines) queued += static_cast<int>(m.operations.size());
+            int operations = 0;
+            for (const auto& [opid, op] : state.operations) operations += op.completed;
+            int completed = 0;
+            for (const auto& [jobId, job] : state.jobs) completed += job.state == State::completed;
+            const int open = static_cast<int>(state.jobs.size()) - completed;
+            ++steps;
+            mismatches += k.runningOperations != running || k.queuedOperations != queued ||
+                k.completedOperations != operations || k.completedJobs != completed || k.openJobs != open;
+        });
+        check(steps > 0 && mismatches == 0,
+              "kpis: " + std::to_string(mismatches) + " of " + std::to_string(steps) + " snapshots miscounted");
+    }
+
+    // under the tardiness objective the tight due dates go first, the makespan order runs the jobs as released
+    void tardinessObjectiveOrdersByDue()
+    {
+        ProductionState state = handShop(1);
+        for (double due : {1000.0, 250.0, 120.0})
+        {
+            addPart(state, {100});
+            state.jobs.rbegin()->second.dueTime = due;
+        }
+        OptiProSimple::ScheduleOptions options;
+        const auto released = listPlan(state, options);
+        options.objective = OptiProSimple::ScheduleObjective::weighted_tardiness;
+        const auto byDue = listPlan(state, options);
+        check(close(OptiProSimple::schedule_tardiness(state, released).weighted_tardiness,
+                    priorityWeight(Priority::normal) * 180.0), "tardiness: the release order is late on the last job");
+        check(OptiProSimple::schedule_tardiness(state, byDue).weighted_tardiness == 0.0,
+              "tardiness: ordering by due date makes every job");
+    }
+
+    // when the queues run against the routings the repair of a failure can't time them and the work is handed out
+    // like new operations, what no other machine can run must wait for the repair instead of being dropped
+    void untimedFailureKeepsWork()
+    {
+        TestShop shop(40, 12, 40);
+        // the last snapshot published before the thread stops is the state the calls below start from
+        StateSnapshot last = shop.run(2000.0, 500.0, [](const StateSnapshot&) {});
+        shop.engine.stop();
+        while (auto snapshot = shop.engine.pollUpdate()) last = std::move(*snapshot);
+        const auto& before = last.productionState;
+
+        // a machine of a type no other machine has, with work queued
+        std::map<MachineType, int> ofType;
+        for (const auto& [mid, m] : before.machines) ++ofType[m.machineType];
+        MachineID failed = -1;
+        for (const auto& [mid, m] : before.machines)
+        {
+            if (ofType[m.machineType] == 1 && m.operations.size() > 1) failed = mid;
+        }
+        check(failed >= 0, "untimed failure: a machine with work only it can run");
+        if (failed < 0) return;
+
+        // every queue reversed, operations of a part on one machine now wait for their successors
+        std::vector<OptiProSimple::ScheduledOp> reversed;
+        for (const auto& [mid, m] : before.machines)
+        {
+            std::vector<OperationID> ops;
+            for (auto q = m.operations; !q.empty(); q.pop()) ops.push_back(q.front());
+            for (auto it = ops.rbegin(); it != ops.rend(); ++it) reversed.push_back({*it, mid, 0.0, 0.0});
+        }
+        shop.engine.applySchedule(reversed);
+        shop.engine.simulateMachineFailure(failed);
+        shop.engine.start();
+        const auto after = shop.send(SetTimeScaleCommand{0.0}, [](const StateSnapshot&) { return true; });
+
+        std::unordered_set<OperationID> held;
+        for (const auto& [mid, m] : after.productionState.machines)
+        {
+            for (auto q = m.operations; !q.empty(); q.pop()) held.insert(q.front());
+        }
+        for (const auto& [mid, runtime] : after.runtime)
+        {
+            if (runtime.current_op) held.insert(*runtime.current_op);
+        }
+        int lost = 0;
+        for (const auto& s : reversed)
+        {
+            lost += !after.productionState.operations.at(s.op_id).completed && !held.count(s.op_id);
+        }
+        check(lost == 0, "untimed failure: " + std::to_string(lost) + " operations left out of every queue");
+    }
+
+    // the diff counts every kind of change, and a high stability penalty keeps queued work on its machine
+    void stabilityDiffCountsMoves()
+    {
+        using OptiProSimple::ScheduledOp;
+        const std::vector<ScheduledOp> before{{1, 0, 0.0, 10.0}, {2, 0, 10.0, 20.0}, {3, 1, 0.0, 10.0},
+                                              {4, 1, 10.0, 20.0}};
+        // 1 and 2 swap, 3 moves to machine 0, 4 is gone and 5 is new
+        const std::vector<ScheduledOp> after{{2, 0, 0.0, 10.0}, {1, 0, 10.0, 20.0}, {3, 0, 20.0, 30.0},
+                                             {5, 1, 0.0, 10.0}};
+        const auto diff = OptiProSimple::diff_schedules(before, after);
+        check(diff.kept == 3 && diff.added == 1 && diff.removed == 1, "plan stability: kept, added and removed");
+        check(diff.moved == 1 && diff.resequenced == 2, "plan stability: moved and resequenced");
+        check(close(diff.maxStartShift, 20.0) && close(diff.meanStartShift, 40.0 / 3.0),
+              "plan stability: start shifts");
+
+        ProductionState state = handShop(2);
+        for (int k = 0; k < 4; ++k) state.machines[0].operations.push(addPart(state, {100}).front());
+        auto moved = [&state](const std::vector<ScheduledOp>& plan)
+        {
+            int count = 0;
+            for (const auto& s : plan) count += s.machine_id != 0;
+            return count;
+        };
+        OptiProSimple::ScheduleOptions options;
+        check(moved(listPlan(state, options)) > 0, "plan stability: a free replan spreads the queue");
+        options.stability_penalty = 1e6;
+        check(moved(listPlan(state, options)) == 0, "plan stability: the penalty keeps the queue in place");
+    }
+
+    // the clock moves by what was fast forwarded and jobs finish on it
+    void finishedOnSimulatedClock()
+    {
+        TestShop shop(40, 30, 40);
+        const auto done = shop.run(60000.0, 500.0, [](const StateSnapshot&) {});
+        const auto& state = done.productionState;
+        check(std::abs(state.time - 60000.0) < 1e-3 && std::abs(done.kpis.time - state.time) < 1e-6,
+              "simulated clock: the engine and the kpis are at the fast forwarded time");
+        int finished = 0;
+        int wrong = 0;
+        for (const auto& [jobId, job] : state.jobs)
+        {
+            if (job.state == State::completed)
+            {
+                ++finished;
+                wrong += !(job.finishedTime > 0.0 && job.finishedTime <= state.time);
+            }
+            else wrong += job.finishedTime != -1.0;
+        }
+        check(finished > 0, "simulated clock: jobs finish");
+        check(wrong == 0, "simulated clock: " + std::to_string(wrong) + " jobs with a finish off the clock");
+    }
+
+    // samples average to the configured means and the event queue hands out only live events in time order
+    void reliabilitySamplesMatchMeans()
+    {
+        std::mt19937 rng(37);
+        for (const auto& life : {LifeDistribution::exponential(100.0), LifeDistribution::weibull(100.0, 2.0),
+                                 LifeDistribution::weibull(100.0, 0.8)})
+        {
+            double total = 0.0;
+            for (int k = 0; k < 40000; ++k) total += life.sample(rng);
+            check(std::abs(total / 40000 - 100.0) < 3.0, "reliability: sample mean " + std::to_string(total / 40000));
+        }
+        Machine machine{};
+        check(std::isinf(ReliabilityModel::never().profile(machine).failure.sample(rng)),
+              "reliability: never() doesnt fail");
+
+        FailureEvents events;
+        events.schedule(50.0, 1, FailureEvents::Kind::failure);
+        events.schedule(20.0, 2, FailureEvents::Kind::failure);
+        events.schedule(30.0, 1, FailureEvents::Kind::repair); // replaces the failure at 50
+        events.cancel(2);
+        check(!events.pop(25.0), "reliability: a cancelled event isnt handed out");
+        const auto repair = events.pop(100.0);
+        check(repair && repair->machine == 1 && repair->kind == FailureEvents::Kind::repair && repair->time == 30.0,
+              "reliability: the live event of the machine is handed out");
+        check(!events.pop(100.0), "reliability: a replaced event isnt handed out");
+    }
+
+    // a plan running a part's operations against its routing can't be timed, its runs are counted apart and
+    // stay out of the distributions
+    void infeasibleRunsAreCounted()
+    {
+        ProductionState state;
+        Part part{};
+        part.id = 1;
+        part.operations = {1, 2};
+        state.parts[part.id] = part;
+        for (OperationID opid : part.operations)
+        {
+            Operation op{};
+            op.id = opid;
+            op.partId = part.id;
+            state.operations[opid] = op;
+        }
+        state.machines[0].id = 0;
+        const std::vector<OptiProSimple::ScheduledOp> inOrder{{1, 0, 0.0, 10.0}, {2, 0, 10.0, 20.0}};
+        const std::vector<OptiProSimple::ScheduledOp> reversed{{2, 0, 0.0, 10.0}, {1, 0, 10.0, 20.0}};
+        for (bool failures : {false, true})
+        {
+            OptiProSimple::MonteCarloOptions options;
+            options.runs = 20;
+            options.failures = failures;
+            options.threads = 1;
+            const auto model = ReliabilityModel::defaults();
+            const auto good = OptiProSimple::monte_carlo_schedule(state, inOrder, model, options);
+            const auto bad = OptiProSimple::monte_carlo_schedule(state, reversed, model, options);
+            const std::string mode = failures ? "with failures" : "without failures";
+            check(good.infeasibleRuns == 0 && good.makespan.max > 0.0,
+                  "infeasible runs " + mode + ": a plan in routing order has none");
+            check(bad.runs == 20 && bad.infeasibleRuns == 20 && bad.makespan.max == 0.0,
+                  "infeasible runs " + mode + ": a plan against the routing is left out");
+        }
+    }
+
+    // scenarios run on copies, an outage at the fork delays the plan and a rush order adds to it
+    void whatIfLeavesForkAlone()
+    {
+        ProductionState state = handShop(2);
+        for (int k = 0; k < 6; ++k) addPart(state, {100});
+        OptiProSimple::ScenarioFork fork;
+        fork.state = std::make_shared<const ProductionState>(state);
+        fork.reliability = ReliabilityModel::never();
+        fork.monte_carlo.runs = 10;
+        fork.monte_carlo.failures = false;
+        fork.monte_carlo.threads = 1;
+
+        WhatIfScenario outage;
+        outage.outages.push_back(MachineOutage{0, 0.0, 1000.0});
+        const auto down = OptiProSimple::evaluate_scenario(fork, outage);
+        check(down.scenario.plannedMakespan > down.baseline.plannedMakespan, "what if: the outage delays the plan");
+
+        WhatIfScenario rush;
+        rush.orders.push_back(RushOrder{1});
+        const auto more = OptiProSimple::evaluate_scenario(fork, rush);
+        check(more.scenario.plannedMakespan > more.baseline.plannedMakespan, "what if: the rush order adds work");
+        check(fork.state->jobs.size() == 6 && fork.state->operations.size() == 6,
+              "what if: the fork state is left as it was");
+    }
+
+    // latest plant snapshot once done holds, nullopt when the router doesnt get there in time
+    std::optional<ShardedSnapshot> waitForPlant(ShardedEngine& plant,
+                                                const std::function<bool(const ShardedSnapshot&)>& done)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            std::optional<ShardedSnapshot> latest;
+            while (auto update = plant.pollUpdate()) latest = std::move(update);
+            if (latest && done(*latest)) return latest;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return std::nullopt;
+    }
+
+    // the router spreads orders over both cells and the plant snapshot adds up what the cells report
+    void shardedPlantAggregates()
+    {
+        ShardOptions options;
+        options.router_period = std::chrono::milliseconds(20);
+        ShardedEngine plant(2, std::chrono::milliseconds(20), 42, options);
+        plant.start();
+        plant.broadcast(SetTimeScaleCommand{0.0});
+        plant.generateShop(40, 8);
+        plant.generateRandomJobs(30);
+        auto routedAll = [](const ShardedSnapshot& s)
+        {
+            int routed = 0;
+            for (int r : s.routed) routed += r;
+            return routed == 30;
+        };
+
+        auto finished = [&routedAll](const ShardedSnapshot& s)
+        {
+            return routedAll(s) && s.pooledOrders == 0 && s.kpis.openJobs == 0;
+        };
+        std::optional<ShardedSnapshot> last;
+        for (int round = 1; round <= 20 && !(last && finished(*last)); ++round)
+        {
+            // the orders the router releases while the cells catch up wait for the next fast forward
+            plant.broadcast(FastForwardCommand{10000.0});
+            const double target = round * 10000.0 - 1e-6;
+            last = waitForPlant(plant, [target](const ShardedSnapshot& s)
+            {
+                if (s.cells.size() != 2) return false;
+                for (const auto& cell : s.cells)
+                {
+                    if (!cell || cell->productionState.time < target) return false;
+                }
+                return true;
+            });
+            if (!last) break;
+        }
+        plant.stop();
+        check(last.has_value() && finished(*last), "sharded plant: every order is routed and completed");
+        if (!last || last->cells.size() != 2) return;
+
+        const auto& k = last->kpis;
+        int completed = 0;
+        int operations = 0;
+        int open = 0;
+        double busy = 0.0;
+        size_t machines = 0;
+        for (const auto& cell : last->cells)
+        {
+            completed += cell->kpis.completedJobs;
+            operations += cell->kpis.completedOperations;
+            open += cell->kpis.openJobs;
+            busy += cell->kpis.averageUtilization * cell->kpis.utilization.size();
+            machines += cell->kpis.utilization.size();
+        }
+        check(last->routed[0] > 0 && last->routed[1] > 0, "sharded plant: both cells get orders");
+        check(k.completedJobs == completed && completed == 30, "sharded plant: completed jobs add up over the cells");
+        check(k.completedOperations == operations && k.openJobs == open,
+              "sharded plant: operation and open job counts add up over the cells");
+        check(machines > 0 && close(k.averageUtilization, busy / machines),
+              "sharded plant: utilization is averaged over the machines of both cells");
+    }
+}
+
+int main()
+{
+    std::cout.setstate(std::ios::failbit); // the engine logs every operation
+    seededGenerationRepeats();
+    bulkGenerationIgnoresThreads();
+    operationToolsFitTheirMachine();
+    routingPrecedenceHolds();
+    setupBatchingSavesSetups();
+    magazineAwareDispatch();
+    toolSwappedMidOperation();
+    packedTableRunsBackToBack();
+    partSizeEligibility();
+    leastLoadedPick();
+    jobCompletionFollowsParts();
+    insertionKeepsQueueOrder();
+    rollingHorizonCoversBacklog();
+    exactBeatsList();
+    geneticNoWorse();
+    batchedEvaluationMatches();
+    kpisMatchSnapshot();
+    tardinessObjectiveOrdersByDue();
+    untimedFailureKeepsWork();
+    stabilityDiffCountsMoves();
+    finishedOnSimulatedClock();
+    reliabilitySamplesMatchMeans();
+    infeasibleRunsAreCounted();
+    whatIfLeavesForkAlone();
+    shardedPlantAggregates();
+    if (failures == 0) std::cerr << "all engine tests passed" << std::endl;
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}